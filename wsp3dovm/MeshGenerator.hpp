@@ -43,14 +43,11 @@
 #define MESHGENERATOR_HH_
 
 #include <vector>
-#include <set>
-#include <map>
 #include <algorithm>
+#include <cstdint>
 
 #include <boost/shared_ptr.hpp>
 #include <boost/progress.hpp>
-#include <boost/tuple/tuple.hpp>
-#include <boost/tuple/tuple_comparison.hpp>
 
 #include <OpenVolumeMesh/Mesh/PolyhedralMesh.hh>
 #include <OpenVolumeMesh/Geometry/VectorT.hh>
@@ -65,7 +62,26 @@ private:
     typedef OpenVolumeMesh::HalfFaceHandle  HalfFaceHandle;
     typedef OpenVolumeMesh::CellHandle      CellHandle;
 
-    typedef boost::tuple<VertexHandle, VertexHandle, VertexHandle> FaceTuple;
+    // sorted vertex triple of a face packed into 96 bits
+    struct FaceKey {
+        uint64_t v01;   // (v0 << 32) | v1
+        uint32_t v2;
+
+        FaceKey() : v01(0), v2(0) {}
+        FaceKey(VertexHandle _v0, VertexHandle _v1, VertexHandle _v2) :
+            v01((uint64_t(uint32_t(_v0.idx())) << 32) | uint32_t(_v1.idx())), v2(uint32_t(_v2.idx())) {}
+
+        VertexHandle vertex(int _i) const {
+            switch(_i) {
+            case 0:  return VertexHandle(int(v01 >> 32));
+            case 1:  return VertexHandle(int(uint32_t(v01)));
+            default: return VertexHandle(int(v2));
+            }
+        }
+
+        bool operator==(const FaceKey& _other) const { return v01 == _other.v01 && v2 == _other.v2; }
+        bool operator<(const FaceKey& _other) const { return v01 < _other.v01 || (v01 == _other.v01 && v2 < _other.v2); }
+    };
 
 public:
 
@@ -77,8 +93,6 @@ public:
     MeshGenerator(const MeshGenerator& _cpy) :
         v_component_(_cpy.v_component_),
         vertex_(0.0, 0.0, 0.0),
-        c_vertices_(),
-        faceMap_(),
         mesh_(_cpy.mesh_),
         progress_() {}
 
@@ -102,22 +116,6 @@ public:
         v_component_ = 0;
     }
 
-	CellHandle add_cell_vertex(unsigned int _idx) {
-
-		CellHandle ch = Kernel::InvalidCellHandle;
-        assert(_idx > 0);
-
-        c_vertices_.push_back(OpenVolumeMesh::VertexHandle((int)_idx - 1));
-        if(c_vertices_.size() == 4) {
-
-            ch = add_tetrahedral_cell();
-//            std::cerr << "Adding cell (" << c_vertices_[0] << ", " << c_vertices_[1] <<
-//                    ", " << c_vertices_[2] << ", " << c_vertices_[3] << ")" << std::endl;
-            c_vertices_.clear();
-        }
-		return ch;
-    }
-
     void set_num_cells(unsigned int _n) {
 
         if(progress_.get() == NULL) {
@@ -125,112 +123,210 @@ public:
         }
     }
 
-    CellHandle add_tetrahedral_cell() {
+    // adds all tetrahedra of _cell_vertices (4 vertices per cell) in one go.
+    // instead of a face and edge lookup per cell, the keys of all 4N cell faces and then of all 3F
+    // face edges are sorted once, each face and edge is identified by its first occurrence.
+    // the topology is added without any searches and the bottom-up incidences are built at the end,
+    // the result is the same mesh as from adding the faces and cells one by one with all incidences enabled.
+    void add_tetrahedral_cells(const std::vector<VertexHandle>& _cell_vertices) {
 
-        if(c_vertices_.size() != 4) {
-            std::cerr << "The specified cell is not incident to four vertices!" << std::endl;
-			return Kernel::InvalidCellHandle;
+        if(_cell_vertices.size() % 4 != 0) {
+            std::cerr << "The specified cells are not incident to four vertices each!" << std::endl;
+            return;
         }
 
-        // Get cell's mid-point
-        Vec3d midP(0.0, 0.0, 0.0);
-        double valence = 0.0;
-        for(std::vector<OpenVolumeMesh::VertexHandle>::const_iterator it = c_vertices_.begin();
-                it != c_vertices_.end(); ++it) {
-            midP += mesh_.vertex(*it);
-            valence += 1.0;
+        const size_t n_cells = _cell_vertices.size() / 4;
+
+        // first_face[e] is the first cell face with the same vertices as cell face e (4 * cell + k)
+        std::vector<uint32_t> first_face(4 * n_cells);
+        {
+            std::vector<FaceEntry> entries(4 * n_cells);
+            for(size_t c = 0; c < n_cells; ++c) {
+                VertexHandle v[4];
+                sorted_cell_vertices(_cell_vertices, c, v);
+                for(int k = 0; k < 4; ++k) {
+                    entries[4 * c + k].key = face_key(v, k);
+                    entries[4 * c + k].entry = uint32_t(4 * c + k);
+                }
+            }
+            first_occurrences(entries, first_face);
         }
-        midP /= valence;
 
-        // Sort vertex vector
-        std::sort(c_vertices_.begin(), c_vertices_.end());
-
-        std::vector<FaceTuple> tuples;
+        // faces are numbered by their first cell face, which also fixes the cell half-faces
+        const int first_fh = int(mesh_.n_faces());
+        std::vector<FaceKey> face_keys;
+        std::vector<HalfFaceHandle> cell_halffaces(4 * n_cells);
+        {
+            std::vector<FaceHandle> faces(4 * n_cells);
+            for(size_t c = 0; c < n_cells; ++c) {
+
+                Vec3d midP = mid_point(&_cell_vertices[4 * c]);
+
+                VertexHandle v[4];
+                sorted_cell_vertices(_cell_vertices, c, v);
+
+                for(int k = 0; k < 4; ++k) {
+                    size_t e = 4 * c + k;
+                    FaceKey key = face_key(v, k);
+                    if(first_face[e] == e) {
+                        faces[e] = FaceHandle(first_fh + int(face_keys.size()));
+                        face_keys.push_back(key);
+                    } else {
+                        faces[e] = faces[first_face[e]];
+                    }
+                    cell_halffaces[e] = inner_halfface(faces[e], key, midP);
+                }
+            }
+        }
+        std::vector<uint32_t>().swap(first_face);
+
+        // the same for the face edges (3 * face + j), a face runs along its sorted vertices v0 v1 v2 v0
+        const size_t n_faces = face_keys.size();
+        std::vector<uint32_t> first_edge(3 * n_faces);
+        {
+            std::vector<EdgeEntry> entries(3 * n_faces);
+            for(size_t f = 0; f < n_faces; ++f) {
+                for(int j = 0; j < 3; ++j) {
+                    VertexHandle from = face_keys[f].vertex(j);
+                    VertexHandle to = face_keys[f].vertex((j + 1) % 3);
+                    entries[3 * f + j].key = edge_key(from, to);
+                    entries[3 * f + j].entry = uint32_t(3 * f + j);
+                }
+            }
+            first_occurrences(entries, first_edge);
+        }
 
-        // Create face tuple for all vertex combinations
-        tuples.push_back(FaceTuple(c_vertices_[0], c_vertices_[1], c_vertices_[2]));
-        tuples.push_back(FaceTuple(c_vertices_[1], c_vertices_[2], c_vertices_[3]));
-        tuples.push_back(FaceTuple(c_vertices_[0], c_vertices_[2], c_vertices_[3]));
-        tuples.push_back(FaceTuple(c_vertices_[0], c_vertices_[1], c_vertices_[3]));
+        // no searches are needed from here on, so the incidences are only built once at the end
+        mesh_.enable_bottom_up_incidences(false);
+
+        // edges are created in the direction of their first face edge like add_face(vertices) does
+        std::vector<HalfEdgeHandle> edge_halfedges(3 * n_faces);
+        face_halfedges_.resize(3);
+        for(size_t f = 0; f < n_faces; ++f) {
+            for(int j = 0; j < 3; ++j) {
+                size_t e = 3 * f + j;
+                VertexHandle from = face_keys[f].vertex(j);
+                if(first_edge[e] == e) {
+                    EdgeHandle eh = mesh_.add_edge(from, face_keys[f].vertex((j + 1) % 3), true);
+                    edge_halfedges[e] = mesh_.halfedge_handle(eh, 0);
+                } else {
+                    HalfEdgeHandle heh = edge_halfedges[first_edge[e]];
+                    edge_halfedges[e] = (mesh_.halfedge(heh).from_vertex() == from) ? heh : mesh_.opposite_halfedge_handle(heh);
+                }
+                face_halfedges_[j] = edge_halfedges[e];
+            }
+            mesh_.add_face(face_halfedges_, false);
+        }
+        std::vector<HalfEdgeHandle>().swap(edge_halfedges);
+        std::vector<uint32_t>().swap(first_edge);
 
-        // Collect cell's half-faces in here
-        std::vector<HalfFaceHandle> cell_halffaces;
+        for(size_t c = 0; c < n_cells; ++c) {
+            cell_halffaces_.assign(cell_halffaces.begin() + 4 * c, cell_halffaces.begin() + 4 * c + 4);
+            add_cell(false);
+        }
 
-        for(std::vector<FaceTuple>::const_iterator it = tuples.begin();
-                it != tuples.end(); ++it) {
+        mesh_.enable_bottom_up_incidences(true);
+    }
 
-            // Check if face exists for current tuple
-            FaceMap::iterator f = faceMap_.find(*it);
-            if(f == faceMap_.end()) {
-                // Face does not exist, create it
+	Mesh& mesh()
+	{
+		return mesh_;
+	}
 
-                // Find right orientation, s.t. normal
-                // points inside the cell
+private:
 
-                Vec3d e1 = mesh_.vertex(it->get<1>()) - mesh_.vertex(it->get<0>());
-                Vec3d e2 = mesh_.vertex(it->get<2>()) - mesh_.vertex(it->get<1>());
+    // cell face and face edge for the bulk mode, sorted by key and then by first occurrence
+    struct FaceEntry {
+        FaceKey key;
+        uint32_t entry;
 
-                // Get face normal (cross product)
-                Vec3d n = (e1 % e2).normalize();
+        bool operator<(const FaceEntry& _other) const {
+            return key < _other.key || (key == _other.key && entry < _other.entry);
+        }
+    };
 
-                std::vector<VertexHandle> v_vec;
-                v_vec.push_back(it->get<0>());
-                v_vec.push_back(it->get<1>());
-                v_vec.push_back(it->get<2>());
-                FaceHandle fh = mesh_.add_face(v_vec);
+    struct EdgeEntry {
+        uint64_t key;   // (min << 32) | max
+        uint32_t entry;
 
-                // Add face to face map
-                faceMap_[*it] = fh;
+        bool operator<(const EdgeEntry& _other) const {
+            return key < _other.key || (key == _other.key && entry < _other.entry);
+        }
+    };
 
-                // Check whether normal points inside cell
-                if(((midP - mesh_.vertex(it->get<0>())) | n) > 0.0) {
+    static uint64_t edge_key(VertexHandle _from, VertexHandle _to) {
 
-                    // Normal points inside cell, just add half-face 0
-                    // Add corresponding half-face to cell definition
-                    cell_halffaces.push_back(mesh_.halfface_handle(fh, 0));
+        uint32_t a = uint32_t(_from.idx());
+        uint32_t b = uint32_t(_to.idx());
+        return (uint64_t(std::min(a, b)) << 32) | std::max(a, b);
+    }
 
-                } else {
+    // sorts _entries and sets _first[entry] to the first entry with the same key
+    template <class Entry>
+    static void first_occurrences(std::vector<Entry>& _entries, std::vector<uint32_t>& _first) {
 
-                    // Normal points outside cell, just add half-face 1
-                    // Add corresponding half-face to cell definition
-                    cell_halffaces.push_back(mesh_.halfface_handle(fh, 1));
-                }
+        std::sort(_entries.begin(), _entries.end());
 
-            } else {
+        for(size_t i = 0; i < _entries.size(); ) {
+            size_t j = i;
+            for(; j < _entries.size() && _entries[j].key == _entries[i].key; ++j)
+                _first[_entries[j].entry] = _entries[i].entry;
+            i = j;
+        }
+    }
 
-                // Face exists, find right orientation
-                FaceHandle fh = f->second;
+    Vec3d mid_point(const VertexHandle* _v) const {
 
-                std::vector<HalfEdgeHandle> hes = mesh_.face(fh).halfedges();
+        // Get cell's mid-point
+        Vec3d midP(0.0, 0.0, 0.0);
+        for(int i = 0; i < 4; ++i)
+            midP += mesh_.vertex(_v[i]);
+        return midP / 4.0;
+    }
 
-                assert(hes.size() == 3);
+    static void sorted_cell_vertices(const std::vector<VertexHandle>& _cell_vertices, size_t _c, VertexHandle* _v) {
 
-                Vec3d e1 = mesh_.vertex(mesh_.halfedge(hes[0]).to_vertex()) -
-                        mesh_.vertex(mesh_.halfedge(hes[0]).from_vertex());
-                Vec3d e2 = mesh_.vertex(mesh_.halfedge(hes[1]).to_vertex()) -
-                        mesh_.vertex(mesh_.halfedge(hes[1]).from_vertex());
+        std::copy(_cell_vertices.begin() + 4 * _c, _cell_vertices.begin() + 4 * _c + 4, _v);
+        std::sort(_v, _v + 4);
+    }
 
-                Vec3d n = (e1 % e2).normalize();
+    // the k-th face of a cell with sorted vertices _v
+    static FaceKey face_key(const VertexHandle* _v, int _k) {
 
-                if(((midP - mesh_.vertex(mesh_.halfedge(hes[0]).from_vertex())) | n) > 0.0) {
-                    // Normal points inside cell
-                    cell_halffaces.push_back(mesh_.halfface_handle(fh, 0));
-                } else {
-                    // Normal points outisde cell
-                    cell_halffaces.push_back(mesh_.halfface_handle(fh, 1));
-                }
-            }
+        switch(_k) {
+        case 0:  return FaceKey(_v[0], _v[1], _v[2]);
+        case 1:  return FaceKey(_v[1], _v[2], _v[3]);
+        case 2:  return FaceKey(_v[0], _v[2], _v[3]);
+        default: return FaceKey(_v[0], _v[1], _v[3]);
         }
+    }
+
+    // a face is created along its sorted vertices, so its normal follows from the key.
+    // returns the half-face whose normal points inside the cell.
+    HalfFaceHandle inner_halfface(FaceHandle _fh, const FaceKey& _key, const Vec3d& _midP) const {
+
+        Vec3d p0 = mesh_.vertex(_key.vertex(0));
+        Vec3d e1 = mesh_.vertex(_key.vertex(1)) - p0;
+        Vec3d e2 = mesh_.vertex(_key.vertex(2)) - mesh_.vertex(_key.vertex(1));
+
+        // Get face normal (cross product)
+        Vec3d n = (e1 % e2).normalize();
+
+        // Check whether normal points inside cell
+        return mesh_.halfface_handle(_fh, (((_midP - p0) | n) > 0.0) ? 0 : 1);
+    }
+
+    CellHandle add_cell(bool _topologyCheck = true) {
 
         // Check whether cell definition contains four half-faces
-        assert(cell_halffaces.size() == 4);
+        assert(cell_halffaces_.size() == 4);
 
         // Finally, add cell
 		CellHandle ch;
 #ifndef NDEBUG
-        ch = mesh_.add_cell(cell_halffaces, true);
+        ch = mesh_.add_cell(cell_halffaces_, _topologyCheck);
 #else
-        ch = mesh_.add_cell(cell_halffaces, false);
+        ch = mesh_.add_cell(cell_halffaces_, false);
 #endif
 
         // Increase progress counter
@@ -240,21 +336,12 @@ public:
 		return ch;
     }
 
-	Mesh& mesh()
-	{
-		return mesh_;
-	}
-
-private:
-
-    typedef std::map<FaceTuple, OpenVolumeMesh::FaceHandle> FaceMap;
-
     unsigned int v_component_;
     OpenVolumeMesh::Geometry::Vec3d vertex_;
 
-    std::vector<VertexHandle> c_vertices_;
-
-    FaceMap faceMap_;
+    // reused for every face and cell
+    std::vector<HalfEdgeHandle> face_halfedges_;
+    std::vector<HalfFaceHandle> cell_halffaces_;
 
     Mesh& mesh_;
 
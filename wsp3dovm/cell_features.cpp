@@ -0,0 +1,125 @@
+#include "cell_features.h"
+#include "parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+
+CellFeatures::CellFeatures(const Mesh& mesh, int num_threads)
+{
+	size_t n = mesh.n_cells();
+	vertices.resize(4 * n);
+	edges.resize(6 * n);
+	faces.resize(4 * n);
+
+	// each cell writes its own entries only
+	parallel_for_chunks(n, 65536, num_threads, [&](size_t begin, size_t end, int)
+	{
+		for (size_t c = begin; c < end; ++c)
+		{
+			int* cell_vertices = &vertices[4 * c];
+			int* cell_edges = &edges[6 * c];
+			int num_vertices = 0;
+			int num_edges = 0;
+			int num_faces = 0;
+
+			for (auto hfh : mesh.cell(CellHandle(static_cast<int>(c))).halffaces())
+			{
+				FaceHandle fh = mesh.face_handle(hfh);
+				faces[4 * c + num_faces++] = fh.idx();
+
+				// each edge of a tetrahedron is shared by two of its faces, each vertex by three
+				for (auto heh : mesh.face(fh).halfedges())
+				{
+					EdgeHandle eh = mesh.edge_handle(heh);
+					if (std::find(cell_edges, cell_edges + num_edges, eh.idx()) != cell_edges + num_edges)
+						continue;
+					cell_edges[num_edges++] = eh.idx();
+
+					Edge edge = mesh.edge(eh);
+					for (VertexHandle vh : { edge.from_vertex(), edge.to_vertex() })
+					{
+						if (std::find(cell_vertices, cell_vertices + num_vertices, vh.idx()) == cell_vertices + num_vertices)
+							cell_vertices[num_vertices++] = vh.idx();
+					}
+				}
+			}
+
+			assert(num_vertices == 4 && num_edges == 6 && num_faces == 4 && "CellFeatures: cell is no tetrahedron");
+		}
+	});
+}
+
+size_t CellFeatures::memory() const
+{
+	return sizeof(int) * (vertices.size() + edges.size() + faces.size());
+}
+
+void set_random_cell_weights(Mesh& mesh)
+{
+	// random_device may be a non-deterministic random number generator using hardware entropy source
+	//std::random_device random_device;
+	std::mt19937 generator /*(random_device())*/;
+	std::uniform_real_distribution<> random_value(1, 1000);
+
+	// is not clear to me, what a good distribution could look like.
+	// the lower limit 1 is such that it is not too close to 0 (where all paths would have equal length 0)
+	// but allows for a higher max/min ratio such that path reflection on faces/edges is quite possible
+	mesh._cellWeight.resize(mesh.n_cells());
+
+	for (auto c_it = mesh.cells_begin(); c_it != mesh.cells_end(); ++c_it)
+	{
+		CellHandle ch = *c_it;
+		mesh.weight(ch) = random_value(generator);
+	}
+}
+
+// cell driven: each cell lowers the weights of its 4 faces and 6 edges to its own weight,
+// features without a cell keep max_weight. the cells are processed in parallel chunks,
+// the weights are non-negative, so an atomic integer min on their bits takes the minimum.
+void calc_face_and_edge_weights(Mesh& mesh, int num_threads)
+{
+	const size_t chunk_size = 65536;
+
+	CellFeatures features(mesh, num_threads);
+
+	size_t n_faces = mesh.n_faces();
+	size_t n_edges = mesh.n_edges();
+
+	// faces first, then edges
+	std::vector<std::atomic<uint64_t>> weights(n_faces + n_edges);
+	parallel_for_chunks(weights.size(), chunk_size, num_threads, [&](size_t begin, size_t end, int)
+	{
+		for (size_t i = begin; i < end; ++i)
+			weights[i].store(ordered_bits(max_weight), std::memory_order_relaxed);
+	});
+
+	parallel_for_chunks(mesh.n_cells(), chunk_size, num_threads, [&](size_t begin, size_t end, int)
+	{
+		for (size_t c = begin; c < end; ++c)
+		{
+			uint64_t weight = ordered_bits(mesh.weight(CellHandle(static_cast<int>(c))));
+
+			for (size_t i = 4 * c; i < 4 * c + 4; ++i)
+				atomic_min(weights[features.faces[i]], weight);
+
+			for (size_t i = 6 * c; i < 6 * c + 6; ++i)
+				atomic_min(weights[n_faces + features.edges[i]], weight);
+		}
+	});
+
+	mesh._faceWeight.resize(n_faces);
+	mesh._edgeWeight.resize(n_edges);
+	parallel_for_chunks(weights.size(), chunk_size, num_threads, [&](size_t begin, size_t end, int)
+	{
+		for (size_t i = begin; i < end; ++i)
+		{
+			double weight = ordered_double(weights[i].load(std::memory_order_relaxed));
+			if (i < n_faces)
+				mesh._faceWeight[i] = weight;
+			else
+				mesh._edgeWeight[i - n_faces] = weight;
+		}
+	});
+}
+
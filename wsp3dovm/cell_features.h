@@ -0,0 +1,28 @@
+#ifndef CELL_FEATURES_H
+#define CELL_FEATURES_H
+
+#include "common.h"
+
+// vertices, edges and faces of each tetrahedron in flat arrays: cell c has the vertices
+// vertices[4c..4c+3], the edges edges[6c..6c+5] and the faces faces[4c..4c+3].
+// cell driven passes over these avoid walking the incidences of the mesh per vertex, edge or face.
+struct CellFeatures
+{
+	// the mesh must be tetrahedral, the cells are processed on num_threads threads (0: all hardware threads)
+	CellFeatures(const Mesh& mesh, int num_threads = 1);
+
+	// bytes allocated for the arrays
+	size_t memory() const;
+
+	std::vector<int> vertices;
+	std::vector<int> edges;
+	std::vector<int> faces;
+};
+
+// pseudo-random cell weights in [1,1000), the same for each run
+void set_random_cell_weights(Mesh& mesh);
+
+// the weight of each face and edge is the minimum weight of its cells, on num_threads threads
+void calc_face_and_edge_weights(Mesh& mesh, int num_threads = 1);
+
+#endif
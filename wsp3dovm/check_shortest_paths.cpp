@@ -0,0 +1,226 @@
+// compares the shortest path searches of wsp3dovm with boost::dijkstra_shortest_paths on the
+// steiner graph of a small cuboid mesh with random cell weights. run by ctest, returns
+// EXIT_FAILURE and prints the first mismatches if any distance or path length differs.
+
+#include "common.h"
+
+#include "cell_features.h"
+#include "create_steinerpoints.h"
+#include "delta_stepping.h"
+#include "dijkstra.h"
+#include "read_tet.h"
+
+#include <cmath>
+#include <sstream>
+
+// the searches sum the same edge weights in different orders, bidirectional queries at the meeting point
+const double tolerance = 1e-12;
+
+// failures are counted, only the first ones are printed
+size_t failures = 0;
+const size_t max_reported_failures = 10;
+
+static bool equal_distances(double a, double b)
+{
+	if (std::isinf(a) || std::isinf(b))
+		return a == b;
+
+	return std::fabs(a - b) <= tolerance * std::max(1.0, std::max(std::fabs(a), std::fabs(b)));
+}
+
+static void check(bool ok, const std::string& what)
+{
+	if (ok)
+		return;
+
+	if (failures < max_reported_failures)
+		std::cout << "FAILED: " << what << std::endl;
+	++failures;
+}
+
+// tetgen text of a cuboid of n x n x n unit cubes, each split into the 6 tetrahedra
+// along the paths from its lowest to its highest corner (Kuhn subdivision, conforming)
+static void build_cuboid(int n, std::ostream& node, std::ostream& ele)
+{
+	const int m = n + 1;
+	auto vertex = [m](int x, int y, int z) { return (z * m + y) * m + x; };
+
+	node << m * m * m << " 3 0 0\n";
+	for (int z = 0; z < m; ++z)
+		for (int y = 0; y < m; ++y)
+			for (int x = 0; x < m; ++x)
+				node << vertex(x, y, z) << " " << x << " " << y << " " << z << "\n";
+
+	const int axes[6][3] = { { 0, 1, 2 }, { 0, 2, 1 }, { 1, 0, 2 }, { 1, 2, 0 }, { 2, 0, 1 }, { 2, 1, 0 } };
+
+	ele << 6 * n * n * n << " 4 0\n";
+	int number = 0;
+	for (int z = 0; z < n; ++z)
+		for (int y = 0; y < n; ++y)
+			for (int x = 0; x < n; ++x)
+				for (const int* axis : axes)
+				{
+					int corner[3] = { x, y, z };
+					ele << number++ << " " << vertex(corner[0], corner[1], corner[2]);
+					for (int k = 0; k < 3; ++k)
+					{
+						++corner[axis[k]];
+						ele << " " << vertex(corner[0], corner[1], corner[2]);
+					}
+					ele << "\n";
+				}
+}
+
+// the lightest edge from u to v
+static double edge_weight(const Graph& graph, GraphNode_descriptor u, GraphNode_descriptor v)
+{
+	double weight = std::numeric_limits<double>::infinity();
+
+	Graph::out_edge_iterator edgeIt, edgeEnd;
+	for (boost::tie(edgeIt, edgeEnd) = boost::out_edges(u, graph); edgeIt != edgeEnd; ++edgeIt)
+	{
+		if (boost::target(*edgeIt, graph) == v)
+			weight = std::min(weight, static_cast<double>(graph[*edgeIt].weight));
+	}
+	return weight;
+}
+
+// length of the predecessor chain from t back to s, infinity if it does not end in s
+static double path_length(const Graph& graph, GraphNode_descriptor s, GraphNode_descriptor t, const DijkstraWorkspace& workspace)
+{
+	std::vector<GraphNode_descriptor> nodes(1, t);
+	while (nodes.back() != s && nodes.size() <= num_vertices(graph))
+	{
+		GraphNode_descriptor u = workspace.predecessor[nodes.back()];
+		if (u == nodes.back())
+			return std::numeric_limits<double>::infinity();
+		nodes.push_back(u);
+	}
+
+	if (nodes.back() != s)
+		return std::numeric_limits<double>::infinity();
+
+	// summed from s on, like the searches do
+	double length = 0;
+	for (size_t i = nodes.size() - 1; i > 0; --i)
+		length += edge_weight(graph, nodes[i], nodes[i - 1]);
+	return length;
+}
+
+int main()
+{
+	const int cubes = 6;
+	const double yardstick = 0.5;
+	const int num_pairs = 50;
+
+	Mesh mesh;
+	{
+		std::stringstream node;
+		std::stringstream ele;
+		build_cuboid(cubes, node, ele);
+		read_tet(mesh, node, ele);
+	}
+	set_random_cell_weights(mesh);
+	calc_face_and_edge_weights(mesh);
+
+	Graph graph;
+	create_steiner_graph_improved_spanner(graph, mesh, 0, yardstick);
+	std::cout << "graph nodes: " << num_vertices(graph) << " edges: " << num_edges(graph) << std::endl;
+
+	std::mt19937 generator;
+	std::uniform_int_distribution<int> random_vertex(0, static_cast<int>(mesh.n_vertices()) - 1);
+
+	std::vector<std::pair<int, int>> pairs;
+	pairs.push_back(std::make_pair(0, static_cast<int>(mesh.n_vertices()) - 1));
+	pairs.push_back(std::make_pair(0, 0));
+	while (pairs.size() < num_pairs)
+		pairs.push_back(std::make_pair(random_vertex(generator), random_vertex(generator)));
+
+	const PriorityQueue queues[] = { QUEUE_BOOST, QUEUE_BINARY, QUEUE_RADIX };
+	const QueryAlgorithm algorithms[] = { QUERY_DIJKSTRA, QUERY_BIDIRECTIONAL, QUERY_ASTAR };
+
+	std::vector<double> reference(num_vertices(graph));
+	std::vector<GraphNode_descriptor> reference_predecessor(num_vertices(graph));
+
+	DijkstraWorkspace workspace(graph);
+	workspace.min_weight = *std::min_element(mesh._cellWeight.begin(), mesh._cellWeight.end());
+
+	size_t queries = 0;
+	for (const std::pair<int, int>& pair : pairs)
+	{
+		GraphNode_descriptor s = mesh.v_node(VertexHandle(pair.first));
+		GraphNode_descriptor t = mesh.v_node(VertexHandle(pair.second));
+
+		boost::dijkstra_shortest_paths
+		(
+			graph,
+			s,
+			boost::weight_map(get(&GraphEdge::weight, graph)).
+			distance_map(boost::make_iterator_property_map(reference.begin(), get(boost::vertex_index, graph))).
+			predecessor_map(boost::make_iterator_property_map(reference_predecessor.begin(), get(boost::vertex_index, graph))).
+			distance_inf(std::numeric_limits<double>::infinity())
+		);
+
+		for (QueryAlgorithm algorithm : algorithms)
+		{
+			for (PriorityQueue queue : queues)
+			{
+				std::stringstream what;
+				what << query_algorithm_name(algorithm) << " (" << priority_queue_name(queue) << " queue) from vertex " << pair.first << " to " << pair.second;
+
+				workspace.queue = queue;
+				shortest_path_query(graph, s, t, algorithm, workspace);
+				++queries;
+
+				check(equal_distances(workspace.distance[t], reference[t]), what.str() + ": distance differs from boost");
+				check(equal_distances(path_length(graph, s, t, workspace), reference[t]), what.str() + ": path length differs from boost");
+			}
+		}
+	}
+
+	// full trees, the last reference is the one of the last pair
+	GraphNode_descriptor root = mesh.v_node(VertexHandle(pairs.back().first));
+
+	for (PriorityQueue queue : queues)
+	{
+		workspace.queue = queue;
+		dijkstra(graph, root, workspace);
+		++queries;
+
+		size_t differences = 0;
+		for (GraphNode_descriptor u = 0; u < num_vertices(graph); ++u)
+			differences += !equal_distances(workspace.distance[u], reference[u]);
+		check(differences == 0, std::string("dijkstra tree (") + priority_queue_name(queue) + " queue): distances differ from boost");
+	}
+
+	const double mean_weight = mean_edge_weight(graph);
+	// the smallest accepted delta spreads long edges beyond the bucket array
+	const double deltas[] = { 0, mean_weight / 8, mean_weight * 8, min_delta(graph) };
+	const int threads[] = { 1, 2, 4 };
+
+	for (double delta : deltas)
+	{
+		for (int num_threads : threads)
+		{
+			std::stringstream what;
+			what << "delta-stepping tree with delta " << delta << " on " << num_threads << " threads";
+
+			delta_stepping(graph, root, delta, num_threads, workspace);
+			++queries;
+
+			size_t differences = 0;
+			size_t bad_paths = 0;
+			for (GraphNode_descriptor u = 0; u < num_vertices(graph); ++u)
+			{
+				differences += !equal_distances(workspace.distance[u], reference[u]);
+				bad_paths += !equal_distances(path_length(graph, root, u, workspace), reference[u]);
+			}
+			check(differences == 0, what.str() + ": distances differ from boost");
+			check(bad_paths == 0, what.str() + ": path lengths differ from boost");
+		}
+	}
+
+	std::cout << queries << " searches checked, " << failures << " failures" << std::endl;
+
+	return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -24,6 +24,7 @@
 #include <boost/graph/subgraph.hpp>
 #include <boost/graph/graph_traits.hpp>
 #include <boost/graph/adjacency_list.hpp>
+#include <boost/graph/compressed_sparse_row_graph.hpp>
 #include <boost/graph/dijkstra_shortest_paths.hpp>
 #include <boost/graph/graphviz.hpp>
 #include <boost/graph/small_world_generator.hpp>
@@ -59,54 +60,147 @@ typedef Kernel::Cell                            Cell;
 typedef Kernel::Face                            Face;
 typedef Kernel::Edge                            Edge;
 
+// edge weights and node coordinates of the graph. building with WSP3DOVM_FLOAT32 stores them in single
+// precision, which halves these arrays for large graphs. mesh weights and search distances stay double.
+#ifdef WSP3DOVM_FLOAT32
+typedef float Weight;
+typedef float Coordinate;
+#else
 typedef double Weight;
+typedef double Coordinate;
+#endif
 
-const Weight max_weight = std::numeric_limits<double>::max();
+const double max_weight = std::numeric_limits<double>::max();	// of mesh features
 
 const double epsilon = 1E-8; // smaller differences are to be considered 0
 
 ///////////////////////////// boost Graph /////////////////////////////
 
-struct GraphNode;
+// the nodes of the steiner graph, stored as arrays next to the graph (as its graph property)
+// instead of a bundle per node: the geometric location as x, y, z and the mesh feature the node
+// was created for as one origin word, the kind of the feature in the top two bits and its index below.
+struct GraphNodes
+{
+	enum Kind { NONE = 0, VERTEX = 1, EDGE = 2, FACE = 3 };
+
+	static const int kind_shift = 30;
+	static const uint32_t index_mask = (1u << kind_shift) - 1;
+
+	size_t size() const { return x.size(); }
+
+	void reserve(size_t n)
+	{
+		x.reserve(n);
+		y.reserve(n);
+		z.reserve(n);
+		origin.reserve(n);
+	}
+
+	// appends a node, the caller adds the matching graph vertex
+	void push_back(const Point& p, Kind kind = NONE, int index = 0)
+	{
+		if (static_cast<uint32_t>(index) > index_mask)
+		{
+			std::cerr << "GraphNodes: mesh feature index " << index << " exceeds the origin index range" << std::endl;
+			exit(EXIT_FAILURE);
+		}
+		x.push_back(static_cast<Coordinate>(p[0]));
+		y.push_back(static_cast<Coordinate>(p[1]));
+		z.push_back(static_cast<Coordinate>(p[2]));
+		origin.push_back((static_cast<uint32_t>(kind) << kind_shift) | static_cast<uint32_t>(index));
+	}
+
+	void clear()
+	{
+		std::vector<Coordinate>().swap(x);
+		std::vector<Coordinate>().swap(y);
+		std::vector<Coordinate>().swap(z);
+		std::vector<uint32_t>().swap(origin);
+	}
+
+	Point point(size_t u) const { return Point(x[u], y[u], z[u]); }
+
+	Kind kind(size_t u) const { return static_cast<Kind>(origin[u] >> kind_shift); }
+	int index(size_t u) const { return static_cast<int>(origin[u] & index_mask); }
+
+	// the original vertex in tetrahedralization, resp. the edge/face for what that node was created
+	VertexHandle vh(size_t u) const { return kind(u) == VERTEX ? VertexHandle(index(u)) : OpenVolumeMesh::TopologyKernel::InvalidVertexHandle; }
+	EdgeHandle eh(size_t u) const { return kind(u) == EDGE ? EdgeHandle(index(u)) : OpenVolumeMesh::TopologyKernel::InvalidEdgeHandle; }
+	FaceHandle fh(size_t u) const { return kind(u) == FACE ? FaceHandle(index(u)) : OpenVolumeMesh::TopologyKernel::InvalidFaceHandle; }
+
+	// bytes allocated for the arrays
+	size_t memory() const
+	{
+		return sizeof(Coordinate) * (x.capacity() + y.capacity() + z.capacity()) + sizeof(uint32_t) * origin.capacity();
+	}
+
+	std::vector<Coordinate> x, y, z;	// geometric location
+	std::vector<uint32_t> origin;
+};
+
 struct GraphEdge;
 
+// the steiner graph is built edge by edge in this one
 typedef 
 		boost::adjacency_list 
 		<
 			boost::vecS,
 			boost::vecS,
 			boost::undirectedS,
-			GraphNode,
-			GraphEdge
+			boost::no_property,
+			GraphEdge,
+			GraphNodes
 		>
-Graph;
+MutableGraph;
 
-typedef boost::graph_traits<Graph>::vertex_descriptor GraphNode_descriptor;
-typedef boost::graph_traits<Graph>::edge_descriptor   GraphEdge_descriptor;
+typedef boost::graph_traits<MutableGraph>::vertex_descriptor MutableGraphNode_descriptor;
+typedef boost::graph_traits<MutableGraph>::edge_descriptor   MutableGraphEdge_descriptor;
 
 ///////////////////////////// boost Graph details /////////////////////////////
 
-struct GraphNode
-{
-public:
-	GraphNode()
-	{
-		// std::cout << "GraphNode()" << std::endl;
-	}
-
-	// the original vertex in tetrahedralization, resp. the edge/face for what that node was created
-	VertexHandle vh = OpenVolumeMesh::TopologyKernel::InvalidVertexHandle;
-	EdgeHandle eh = OpenVolumeMesh::TopologyKernel::InvalidEdgeHandle;
-	FaceHandle fh = OpenVolumeMesh::TopologyKernel::InvalidFaceHandle;
-	Point point;	// geometric location
-};
-
 struct GraphEdge
 {
 	// we could have done this with internal properties too
 	Weight weight;
 };
 
+// ... and then frozen into compressed sparse row format for the queries.
+// each undirected edge is stored once per direction, the out edges of a node are contiguous.
+// 32 bit node numbers suffice and halve the size of the adjacency arrays.
+typedef
+		boost::compressed_sparse_row_graph
+		<
+			boost::directedS,
+			boost::no_property,
+			GraphEdge,
+			GraphNodes,
+			uint32_t,	// node numbers
+			size_t		// edge numbers
+		>
+Graph;
+
+typedef boost::graph_traits<Graph>::vertex_descriptor GraphNode_descriptor;
+typedef boost::graph_traits<Graph>::edge_descriptor   GraphEdge_descriptor;
+
+// number of undirected edges of the graph
+static inline size_t num_graph_edges(const Graph& graph)
+{
+	return num_edges(graph) / 2;
+}
+
+// the node arrays of a graph
+template <class G>
+static inline const GraphNodes& graph_nodes(const G& graph)
+{
+	return graph[boost::graph_bundle];
+}
+
+template <class G>
+static inline GraphNodes& graph_nodes(G& graph)
+{
+	return graph[boost::graph_bundle];
+}
+
 struct Mesh : public OpenVolumeMesh::GeometricPolyhedralMeshV3d
 {
 	std::vector<double> _cellWeight;
@@ -208,13 +302,14 @@ static inline std::set<CellHandle> cells_from_graph_nodes
 )
 {
 	std::set<CellHandle> cells;
+	const GraphNodes& nodes = graph_nodes(graph);
 
 	GraphNode_descriptor r = t;
 	for (;;)
 	{
-		if (graph[r].vh != OpenVolumeMesh::TopologyKernel::InvalidVertexHandle)
+		if (nodes.kind(r) == GraphNodes::VERTEX)
 		{
-			VertexHandle vh = graph[r].vh;
+			VertexHandle vh = nodes.vh(r);
 
 			//std::cout << "vrtx node " << vh.idx() << std::endl;
 			for (auto vc_iter = mesh.vc_iter(vh); vc_iter.valid(); ++vc_iter)
@@ -227,9 +322,9 @@ static inline std::set<CellHandle> cells_from_graph_nodes
 				}
 			}
 		}
-		else if (graph[r].eh != OpenVolumeMesh::TopologyKernel::InvalidEdgeHandle)
+		else if (nodes.kind(r) == GraphNodes::EDGE)
 		{
-			EdgeHandle eh = graph[r].eh;
+			EdgeHandle eh = nodes.eh(r);
 			//std::cout << "edge node " << eh.idx() << std::endl;
 
 			// we can choose either halfegde, both yield the same set (tested)
@@ -244,9 +339,9 @@ static inline std::set<CellHandle> cells_from_graph_nodes
 				}
 			}
 		}
-		else if (graph[r].fh != OpenVolumeMesh::TopologyKernel::InvalidFaceHandle)
+		else if (nodes.kind(r) == GraphNodes::FACE)
 		{
-			FaceHandle fh = graph[r].fh;
+			FaceHandle fh = nodes.fh(r);
 			//std::cout << "face node " << fh.idx() << std::endl;
 
 			HalfFaceHandle hfh0 = mesh.halfface_handle(fh, 0);
@@ -1,21 +1,30 @@
 #include "create_steinerpoints.h"
+#include "cell_features.h"
+#include "parallel.h"
 
 
+// adds a graph node at p which was created for the mesh feature (kind, index)
+static GraphNode_descriptor add_node(MutableGraph &graph, const Point &p, GraphNodes::Kind kind = GraphNodes::NONE, int index = 0)
+{
+	GraphNode_descriptor node = boost::add_vertex(graph);
+	graph_nodes(graph).push_back(p, kind, index);
+	return node;
+}
+
 // utmost simple scheme: one point per cell, the barycenter
-static void create_barycentric_steiner_points_for_cell(Graph &graph, std::vector<GraphNode_descriptor> &steiner_points, Mesh &mesh, CellHandle ch)
+static void create_barycentric_steiner_points_for_cell(MutableGraph &graph, std::vector<GraphNode_descriptor> &steiner_points, Mesh &mesh, CellHandle ch)
 {
 	Point center = mesh.barycenter(ch);
 
-	GraphNode_descriptor node = boost::add_vertex(graph);
-	graph[node].point = center;
+	GraphNode_descriptor node = add_node(graph, center);
 
 	steiner_points[ch.idx()] = node;
 }
 
-static void connect_barycentric_steiner_points_for_cell(Graph &graph, std::vector<GraphNode_descriptor> &steiner_points, Mesh &mesh, CellHandle ch)
+static void connect_barycentric_steiner_points_for_cell(MutableGraph &graph, std::vector<GraphNode_descriptor> &steiner_points, Mesh &mesh, CellHandle ch)
 {
 	GraphNode_descriptor u = steiner_points[ch.idx()];
-	Point pu = graph[u].point;
+	Point pu = graph_nodes(graph).point(u);
 
 	std::vector<HalfFaceHandle> halffaces = mesh.cell(ch).halffaces();
 
@@ -32,14 +41,14 @@ static void connect_barycentric_steiner_points_for_cell(Graph &graph, std::vecto
 		if (och.is_valid())
 		{
 			GraphNode_descriptor v = steiner_points[och.idx()];
-			Point pv = graph[v].point;
+			Point pv = graph_nodes(graph).point(v);
 
 			Weight edge_weight = static_cast<Weight>((pu - pv).norm()); // TODO: weighted length !
 
 			//Weight w0 = sqrt(SquaredDistPoint3Triangle3( pu, p0, p1, p2));
 			//Weight w1 = sqrt(SquaredDistPoint3Triangle3( pv, p0, p1, p2));
 		
-			GraphEdge_descriptor edge;
+			MutableGraphEdge_descriptor edge;
 			bool inserted;
 			boost::tie(edge, inserted) = boost::add_edge(u, v, graph);
 			assert(inserted);
@@ -48,7 +57,7 @@ static void connect_barycentric_steiner_points_for_cell(Graph &graph, std::vecto
 	}
 }
 
-void create_barycentric_steiner_points(Graph &graph, Mesh &mesh)
+void create_barycentric_steiner_points(MutableGraph &graph, Mesh &mesh)
 {
 	std::vector<GraphNode_descriptor> steiner_points(mesh.n_cells());
 
@@ -74,7 +83,7 @@ void create_barycentric_steiner_points(Graph &graph, Mesh &mesh)
 /////////////////////////////////////////////////////////////////////////////////////////////
 // second strategy: use all vertices as graph nodes, create steiner points for faces and edges
 
-void connect_surface_steiner_points_for_cell(Graph &graph, Mesh& mesh, CellHandle ch)
+void connect_surface_steiner_points_for_cell(MutableGraph &graph, Mesh& mesh, CellHandle ch)
 {
 	for (auto hfh1 : mesh.cell(ch).halffaces())
 	{
@@ -91,11 +100,11 @@ void connect_surface_steiner_points_for_cell(Graph &graph, Mesh& mesh, CellHandl
 				{
 					for (auto f2_node : mesh.f_nodes(fh2))
 					{
-						GraphEdge_descriptor edge;
+						MutableGraphEdge_descriptor edge;
 						bool inserted;
 						boost::tie(edge, inserted) = boost::add_edge(f1_node, f2_node, graph);
-						double length = norm(graph[f1_node].point, graph[f2_node].point);
-						graph[edge].weight = length * mesh.weight(ch);
+						double length = norm(graph_nodes(graph).point(f1_node), graph_nodes(graph).point(f2_node));
+						graph[edge].weight = static_cast<Weight>(length * mesh.weight(ch));
 						assert(inserted);
 					}
 				}
@@ -104,7 +113,7 @@ void connect_surface_steiner_points_for_cell(Graph &graph, Mesh& mesh, CellHandl
 	}
 }
 
-void connect_surface_steiner_points_for_face(Graph &graph, Mesh& mesh, FaceHandle fh)
+void connect_surface_steiner_points_for_face(MutableGraph &graph, Mesh& mesh, FaceHandle fh)
 {
 	// incident edge-edge connections
 	for (auto heh1 : mesh.face(fh).halfedges())
@@ -122,11 +131,11 @@ void connect_surface_steiner_points_for_face(Graph &graph, Mesh& mesh, FaceHandl
 				{
 					for (auto e2_node : mesh.e_nodes(eh2))
 					{
-						GraphEdge_descriptor edge;
+						MutableGraphEdge_descriptor edge;
 						bool inserted;
 						boost::tie(edge, inserted) = boost::add_edge(e1_node, e2_node, graph);
-						double length = norm(graph[e1_node].point, graph[e2_node].point );
-						graph[edge].weight = length * mesh.weight(fh);
+						double length = norm(graph_nodes(graph).point(e1_node), graph_nodes(graph).point(e2_node) );
+						graph[edge].weight = static_cast<Weight>(length * mesh.weight(fh));
 						assert(inserted);
 					}
 				}
@@ -143,18 +152,18 @@ void connect_surface_steiner_points_for_face(Graph &graph, Mesh& mesh, FaceHandl
 		{
 			for (auto f_node : mesh.f_nodes(fh))
 			{
-				GraphEdge_descriptor edge;
+				MutableGraphEdge_descriptor edge;
 				bool inserted;
 				boost::tie(edge, inserted) = boost::add_edge( e_node, f_node, graph);
-				double length = norm( graph[e_node].point, graph[f_node].point );
-				graph[edge].weight = length * mesh.weight(fh);
+				double length = norm( graph_nodes(graph).point(e_node), graph_nodes(graph).point(f_node) );
+				graph[edge].weight = static_cast<Weight>(length * mesh.weight(fh));
 				assert(inserted);
 			}
 		}
 	}
 }
 
-void connect_surface_steiner_points_for_edge(Graph& graph, Mesh& mesh, EdgeHandle eh)
+void connect_surface_steiner_points_for_edge(MutableGraph& graph, Mesh& mesh, EdgeHandle eh)
 {
 	Edge e = mesh.edge(eh);
 	VertexHandle v1 = e.from_vertex();
@@ -166,8 +175,8 @@ void connect_surface_steiner_points_for_edge(Graph& graph, Mesh& mesh, EdgeHandl
 	assert(mesh.e_nodes(eh).size()==1);
 	for (auto node : mesh.e_nodes(eh))
 	{
-		GraphEdge_descriptor edge1;
-		GraphEdge_descriptor edge2;
+		MutableGraphEdge_descriptor edge1;
+		MutableGraphEdge_descriptor edge2;
 
 		bool inserted;
 		boost::tie(edge1, inserted) = boost::add_edge(node1, node, graph);
@@ -175,15 +184,15 @@ void connect_surface_steiner_points_for_edge(Graph& graph, Mesh& mesh, EdgeHandl
 		boost::tie(edge2, inserted) = boost::add_edge(node, node2, graph);
 		assert(inserted);
 		
-		double length1 = norm(graph[node1].point, graph[node].point);
-		double length2 = norm(graph[node].point, graph[node2].point);
+		double length1 = norm(graph_nodes(graph).point(node1), graph_nodes(graph).point(node));
+		double length2 = norm(graph_nodes(graph).point(node), graph_nodes(graph).point(node2));
 
-		graph[edge1].weight = length1 * mesh.weight(eh);
-		graph[edge2].weight = length2 * mesh.weight(eh);
+		graph[edge1].weight = static_cast<Weight>(length1 * mesh.weight(eh));
+		graph[edge2].weight = static_cast<Weight>(length2 * mesh.weight(eh));
 	}
 }
 
-void create_surface_steiner_points(Graph &graph, Mesh &mesh)
+void create_surface_steiner_points(MutableGraph &graph, Mesh &mesh)
 {
 	mesh._vertexNode.resize(mesh.n_vertices());
 
@@ -193,9 +202,7 @@ void create_surface_steiner_points(Graph &graph, Mesh &mesh)
 		VertexHandle vh = *it;
 		if (vh.is_valid())
 		{
-			GraphNode_descriptor node = boost::add_vertex(graph);
-			graph[node].vh = vh;
-			graph[node].point = mesh.vertex(vh);
+			GraphNode_descriptor node = add_node(graph, mesh.vertex(vh), GraphNodes::VERTEX, vh.idx());
 			mesh.v_node(vh) = node;
 		}
 	}
@@ -208,8 +215,7 @@ void create_surface_steiner_points(Graph &graph, Mesh &mesh)
 		EdgeHandle eh = *it;
 		if (eh.is_valid())
 		{
-			GraphNode_descriptor node = boost::add_vertex(graph);
-			graph[node].point = mesh.barycenter(eh);
+			GraphNode_descriptor node = add_node(graph, mesh.barycenter(eh));
 			mesh.e_nodes(eh).push_back(node);
 		}
 	}
@@ -221,8 +227,7 @@ void create_surface_steiner_points(Graph &graph, Mesh &mesh)
 		FaceHandle fh = *it;
 		if (fh.is_valid())
 		{
-			GraphNode_descriptor node = boost::add_vertex(graph);
-			graph[node].point = mesh.barycenter(fh);
+			GraphNode_descriptor node = add_node(graph, mesh.barycenter(fh));
 			mesh.f_nodes(fh).push_back(node);
 		}
 	}
@@ -298,29 +303,6 @@ bool PointInTriangle(const Point& P, const Point& A, const Point& B, const Point
 	return (r + t < 1);
 }
 
-// this will add an edge (u,v) only if
-// 1 no such edge exists in graph, or
-// 2 existing edge is more expensive (because it runs across a face or mesh edge of a more expensive cell)
-// in the latter case, weight will be adjusted
-void add_edge(Graph &graph, GraphNode_descriptor u, GraphNode_descriptor v, Weight cellcost)
-{
-	Weight weight = cellcost * norm(graph[u].point, graph[v].point);
-
-	// this pair stuff is counter intuitive. first is the edge, second the bool
-	std::pair<Graph::edge_descriptor, bool> retrievedEdge = boost::edge(u, v, graph);
-	if (retrievedEdge.second)
-	{
-		graph[retrievedEdge.first].weight = std::min(weight, graph[retrievedEdge.first].weight);
-		//std::cout << "updating edge weigth of edge " << u << ", " << v << std::endl;
-	}
-	else
-	{
-		std::pair<Graph::edge_descriptor, bool> newEdge = boost::add_edge(u, v, graph);
-		graph[newEdge.first].weight = weight;
-		//std::cout << "adding new edge " << u << ", " << v << std::endl;
-	}
-}
-
 struct edge_length_less_than
 {
 	edge_length_less_than(const Mesh& mesh) : mesh(mesh) {}
@@ -333,7 +315,7 @@ struct edge_length_less_than
 	}
 };
 
-void create_steiner_graph_nodes_interval_scheme_for_face(Graph &graph, Mesh &mesh, double yardstick, FaceHandle fh)
+void create_steiner_graph_nodes_interval_scheme_for_face(MutableGraph &graph, Mesh &mesh, double yardstick, FaceHandle fh)
 {
 	//HalfFaceHandle hfh = Kernel::halfface_handle(fh, 0); // pick an arbitrary orientation
 
@@ -421,25 +403,21 @@ void create_steiner_graph_nodes_interval_scheme_for_face(Graph &graph, Mesh &mes
 			
 			if (PointInTriangle(p,pu,pv,pw))
 			{
-				GraphNode_descriptor node = boost::add_vertex(graph);
-				graph[node].point = p;
-				graph[node].fh = fh;
+				GraphNode_descriptor node = add_node(graph, p, GraphNodes::FACE, fh.idx());
 				mesh.f_nodes(fh).push_back(node);
 			}
 		}
 	}
 }
 
-void create_steiner_graph_nodes_interval_scheme(Graph &graph, Mesh &mesh, double yardstick)
+void create_steiner_graph_nodes_interval_scheme(MutableGraph &graph, Mesh &mesh, double yardstick)
 {
 	// create a graph node for each mesh vertex
 	mesh._vertexNode.resize(mesh.n_vertices());
 	for (auto it = mesh.vertices_begin(); it != mesh.vertices_end(); ++it)
 	{
 		VertexHandle vh = *it;
-		GraphNode_descriptor node = boost::add_vertex(graph);
-		graph[node].vh = vh;
-		graph[node].point = mesh.vertex(vh);
+		GraphNode_descriptor node = add_node(graph, mesh.vertex(vh), GraphNodes::VERTEX, vh.idx());
 		mesh.v_node(vh) = node;
 	}
 
@@ -462,10 +440,8 @@ void create_steiner_graph_nodes_interval_scheme(Graph &graph, Mesh &mesh, double
 			// we subdivide each edge into equally sized segments of length <= yardstick
 			for (int i = 1; i < k; ++i)
 			{
-				GraphNode_descriptor node = boost::add_vertex(graph);
 				Point p = pu + (static_cast<double>(i) / static_cast<double>(k)) * edge_direction;
-				graph[node].point = p;
-				graph[node].eh = eh;
+				GraphNode_descriptor node = add_node(graph, p, GraphNodes::EDGE, eh.idx());
 				mesh.e_nodes(eh).push_back(node);
 			}
 			//std::cout << "added " << k << " steiner points to edge (" << u << "," << v << ") of length " << edge_length << std::endl;
@@ -487,198 +463,529 @@ void create_steiner_graph_nodes_interval_scheme(Graph &graph, Mesh &mesh, double
 	}
 }
 
-std::vector<GraphNode_descriptor> cell_nodes(Graph &graph, Mesh &mesh, CellHandle ch)
+// collect all graph nodes belonging to cell c into nodes: the face nodes, edge nodes and vertex nodes
+// of the features listed in the flat cell table, so no mesh incidences are walked
+static void cell_nodes(const Mesh &mesh, const CellFeatures &features, size_t c, std::vector<GraphNode_descriptor> &nodes)
 {
-	std::set<EdgeHandle> edges;			// edges of cell
-	std::set<VertexHandle> vertices;	// vertices of cell
+	nodes.clear();
 
-	std::vector<GraphNode_descriptor> all_nodes;
-	// collect all graph nodes belonging to that cell
+	for (size_t i = 4 * c; i < 4 * c + 4; ++i)
+	{
+		const std::vector<GraphNode_descriptor>& face_nodes = mesh.f_nodes(FaceHandle(features.faces[i]));
+		nodes.insert(nodes.end(), face_nodes.begin(), face_nodes.end());
+	}
 
-	for (auto hfh : mesh.cell(ch).halffaces())
+	for (size_t i = 6 * c; i < 6 * c + 6; ++i)
 	{
-		FaceHandle fh = mesh.face_handle(hfh);
-		all_nodes.insert(all_nodes.end(), mesh.f_nodes(fh).begin(), mesh.f_nodes(fh).end());
+		const std::vector<GraphNode_descriptor>& edge_nodes = mesh.e_nodes(EdgeHandle(features.edges[i]));
+		nodes.insert(nodes.end(), edge_nodes.begin(), edge_nodes.end());
+	}
 
-		Face face = mesh.face(fh);
+	for (size_t i = 4 * c; i < 4 * c + 4; ++i)
+	{
+		nodes.push_back(mesh.v_node(VertexHandle(features.vertices[i])));
+	}
+}
 
-		for (auto heh : face.halfedges())
-		{
-			EdgeHandle eh = mesh.edge_handle(heh);
-			if (edges.find(eh) == edges.end())
-			{
-				all_nodes.insert(all_nodes.end(), mesh.e_nodes(eh).begin(), mesh.e_nodes(eh).end());
-				edges.insert(eh);
+// the edges of the cells one thread has processed, by shard. they are merged into the edge index
+// whenever edges_per_thread of them are buffered, so all buffers together stay below num_threads * edges_per_thread
+// edges, however many edges a single cell produces. the merges of different threads run in parallel
+// as long as they hit different shards.
+class EdgeBuffer
+{
+public:
+	static const size_t edges_per_thread = size_t(1) << 18;
 
-				Edge edge = mesh.edge(eh);
+	EdgeBuffer() : index(nullptr), count(0) {}
 
-				VertexHandle vh1 = edge.from_vertex();
-				if (vertices.find(vh1) == vertices.end())
-				{
-					all_nodes.insert(all_nodes.end(), mesh.v_node(vh1));
-					vertices.insert(vh1);
-				}
+	void reset(EdgeIndex &edges)
+	{
+		index = &edges;
+		parts.assign(edges.num_shards(), std::vector<WeightedEdge>());
+		count = 0;
+	}
 
-				VertexHandle vh2 = edge.to_vertex();
-				if (vertices.find(vh2) == vertices.end())
-				{
-					all_nodes.insert(all_nodes.end(), mesh.v_node(vh2));
-					vertices.insert(vh2);
-				}
+	void push_back(const WeightedEdge &edge)
+	{
+		parts[index->shard(edge)].push_back(edge);
+		if (++count >= edges_per_thread)
+			flush();
+	}
+
+	void flush()
+	{
+		// shards held by other threads are skipped first and waited for in the second round
+		for (int round = 0; round < 2 && count > 0; ++round)
+		{
+			for (size_t s = 0; s < parts.size(); ++s)
+			{
+				if (parts[s].empty() || !index->add(s, parts[s], round == 1))
+					continue;
+
+				count -= parts[s].size();
+				// a part that took most of the buffer once would keep its capacity for good
+				if (parts[s].capacity() > 2 * edges_per_thread / parts.size())
+					std::vector<WeightedEdge>().swap(parts[s]);
+				else
+					parts[s].clear();
 			}
 		}
 	}
-	return all_nodes;
-}
 
-// after fighting with boost::subgraph for a while, I decided to re-invent the wheel
+private:
+	EdgeIndex *index;
+	std::vector<std::vector<WeightedEdge>> parts;
+	size_t count;
+};
 
-struct SpannerGraphNode;
-struct SpannerGraphEdge;
+// the greedy spanner of a cell works on local node numbers 0..k-1
 
-typedef
-boost::adjacency_list
-<
-	boost::vecS,
-	boost::vecS,
-	boost::undirectedS,
-	SpannerGraphNode,
-	SpannerGraphEdge
->
-SpannerGraph;
+struct SpannerEdge
+{
+	SpannerEdge(size_t u, size_t v, double length) : u(u), v(v), length(length) {}
 
-typedef boost::graph_traits<SpannerGraph>::vertex_descriptor SpannerGraphNode_descriptor;
-typedef boost::graph_traits<SpannerGraph>::edge_descriptor   SpannerGraphEdge_descriptor;
+	bool operator < (const SpannerEdge &rhs) const { return length < rhs.length; }
 
-struct SpannerGraphNode
-{
-	GraphNode_descriptor original_node;
+	size_t u;
+	size_t v;
+	double length;
 };
 
-struct SpannerGraphEdge
+// buffers for the edges of one cell, each thread reuses its own for all cells
+struct SpannerWorkspace
 {
-	SpannerGraphEdge() : length(-1) {}
-
-	SpannerGraphEdge(SpannerGraphNode_descriptor u, SpannerGraphNode_descriptor v, double length)
-	: u(u), v(v), length(length)
+	// sets up an empty spanner for k nodes
+	void resize(size_t k)
 	{
+		size = k;
+
+		distance_matrix.assign(k * k, std::numeric_limits<double>::infinity());
+		for (size_t u = 0; u < k; ++u)
+			distance_matrix[u * k + u] = 0;
+
+		if (adjacency.size() < k)
+			adjacency.resize(k);
+		for (size_t u = 0; u < k; ++u)
+			adjacency[u].clear();
+
+		distance.assign(k, std::numeric_limits<double>::infinity());
+		potential_edges.clear();
 	}
 
-	bool operator < (const SpannerGraphEdge &rhs) const { return length < rhs.length; }
+	std::vector<GraphNode_descriptor> nodes;	// graph nodes of the cell
 
-	SpannerGraphNode_descriptor u;
-	SpannerGraphNode_descriptor v;
-	double length;
+	size_t size;
+
+	// upper bounds for the spanner distances of all node pairs. the spanner only grows,
+	// so a distance found once stays an upper bound
+	std::vector<double> distance_matrix;
+
+	std::vector<std::vector<std::pair<size_t, double>>> adjacency;	// spanner edges (node, length)
+	std::vector<SpannerEdge> potential_edges;
+
+	// bounded dijkstra, distance is kept at infinity between the searches
+	std::vector<double> distance;
+	std::vector<std::pair<double, size_t>> queue;
+	std::vector<size_t> reached;
 };
 
-// stretch: stretch factor t of spanner graph 
-// yardstick: interval length for edge subdivisions
-void create_steiner_graph_improved_spanner(Graph &graph, Mesh &mesh, double stretch, double yardstick)
+// dijkstra from s in the spanner which ignores paths longer than bound,
+// returns true iff the spanner distance from s to t is <= bound.
+// all nodes settled on the way refresh the upper bounds in the distance matrix.
+static bool spanner_distance_within(SpannerWorkspace &ws, size_t s, size_t t, double bound)
 {
-	create_steiner_graph_nodes_interval_scheme(graph, mesh, yardstick);
+	typedef std::pair<double, size_t> QueueEntry;
+	std::greater<QueueEntry> later;
 
-	if (stretch == 0)
-	{	// no stretch allowed, build complete graph (faster)
+	bool found = false;
 
-		std::cout << "adding graph edges (complete subgraphs) for " <<mesh.n_cells()  << " cells" << std::endl;
+	ws.distance[s] = 0;
+	ws.reached.push_back(s);
+	ws.queue.push_back(QueueEntry(0, s));
+
+	while (!ws.queue.empty())
+	{
+		std::pop_heap(ws.queue.begin(), ws.queue.end(), later);
+		QueueEntry entry = ws.queue.back();
+		ws.queue.pop_back();
+
+		double d = entry.first;
+		size_t u = entry.second;
+		if (d > ws.distance[u])
+			continue; // outdated entry
 
-		int c = 0;
-		for (auto it = mesh.cells_begin(); it != mesh.cells_end(); ++it)
+		double& bound_su = ws.distance_matrix[s * ws.size + u];
+		double& bound_us = ws.distance_matrix[u * ws.size + s];
+		bound_su = std::min(bound_su, d);
+		bound_us = std::min(bound_us, d);
+
+		if (u == t)
 		{
-			c++;
-			if ((c % 100) == 0)
-				std::cout << "\r" << c << " cells processed";
+			found = true;
+			break;
+		}
 
-			CellHandle ch = *it;
-			std::vector<GraphNode_descriptor> nodes = cell_nodes(graph, mesh, ch);
+		for (auto neighbor : ws.adjacency[u])
+		{
+			size_t v = neighbor.first;
+			double dv = d + neighbor.second;
 
-			for (auto nit1 = nodes.begin(); nit1 != nodes.end(); ++nit1)
+			if (dv <= bound && dv < ws.distance[v])
 			{
-				for (auto nit2 = nit1 + 1; nit2 != nodes.end(); ++nit2)
-				{
-					add_edge(graph, *nit1, *nit2, mesh.weight(ch));
-				}
+				if (ws.distance[v] == std::numeric_limits<double>::infinity())
+					ws.reached.push_back(v);
+
+				ws.distance[v] = dv;
+				ws.queue.push_back(QueueEntry(dv, v));
+				std::push_heap(ws.queue.begin(), ws.queue.end(), later);
 			}
 		}
-		return;
 	}
 
-	std::cout << "adding graph edges (spanner subgraphs) for " <<mesh.n_cells()  << " cells" << std::endl;
-	
-	int c = 0;
-	for (auto it = mesh.cells_begin(); it != mesh.cells_end(); ++it)
+	for (auto u : ws.reached)
+		ws.distance[u] = std::numeric_limits<double>::infinity();
+	ws.reached.clear();
+	ws.queue.clear();
+
+	return found;
+}
+
+// no stretch allowed, connect all nodes of the cell (complete subgraph)
+static void complete_cell_edges(MutableGraph &graph, Mesh &mesh, const CellFeatures &features, CellHandle ch, SpannerWorkspace &ws, EdgeBuffer &edges)
+{
+	cell_nodes(mesh, features, ch.idx(), ws.nodes);
+	const std::vector<GraphNode_descriptor>& nodes = ws.nodes;
+
+	const GraphNodes& points = graph_nodes(graph);
+
+	for (auto nit1 = nodes.begin(); nit1 != nodes.end(); ++nit1)
 	{
-		c++;
-		if ((c % 100) == 0)
-			std::cout << "\r" << c << " cells processed";
+		for (auto nit2 = nit1 + 1; nit2 != nodes.end(); ++nit2)
+		{
+			Weight weight = static_cast<Weight>(mesh.weight(ch) * norm(points.point(*nit1), points.point(*nit2)));
+			edges.push_back(WeightedEdge(*nit1, *nit2, weight));
+		}
+	}
+}
 
-		CellHandle ch = *it;
+// greedy spanner for the nodes of the cell, this is the improved version of
+// http://cg.scs.carleton.ca/~mfarshi/pub/ESA05.pdf: a potential edge (u,v) is rejected by the
+// cached distance matrix if possible, otherwise by a dijkstra that stops at (1 + stretch) * |uv|.
+// the spanner is the same as the one of the plain greedy algorithm with a full dijkstra per potential edge.
+static void spanner_cell_edges(MutableGraph &graph, Mesh &mesh, const CellFeatures &features, CellHandle ch, double stretch, SpannerWorkspace &ws, EdgeBuffer &edges)
+{
+	cell_nodes(mesh, features, ch.idx(), ws.nodes);
+	const std::vector<GraphNode_descriptor>& nodes = ws.nodes;
 
-		std::vector<GraphNode_descriptor> nodes = cell_nodes(graph, mesh, ch);
+	const GraphNodes& points = graph_nodes(graph);
 
-		SpannerGraph spanner;
+	size_t k = nodes.size();
+	ws.resize(k);
 
-		for (auto node : nodes)
+	// now we build a sorted list of potential edges
+	for (size_t u = 0; u < k; ++u)
+	{
+		for (size_t v = u + 1; v < k; ++v)
 		{
-			SpannerGraphNode_descriptor u = boost::add_vertex(spanner);
-			spanner[u].original_node = node;
+			double length = norm(points.point(nodes[u]), points.point(nodes[v]));
+//			assert(length > 0);
+			ws.potential_edges.push_back(SpannerEdge(u, v, length));
 		}
+	}
+
+	// sort edges by length
+	std::sort(ws.potential_edges.begin(), ws.potential_edges.end());
 
-		// now we build a sorted list of potential edges
-		std::vector<SpannerGraphEdge> potential_edges;
+	for (auto potential_edge : ws.potential_edges)
+	{
+		size_t u = potential_edge.u;
+		size_t v = potential_edge.v;
 
-		auto uit = vertices(spanner);
-		for (auto u = uit.first; u != uit.second; ++u)
+		double bound = (1 + stretch) * potential_edge.length;
+
+		// the spanner contains a short enough path already
+		if (ws.distance_matrix[u * k + v] <= bound)
+			continue;
+
+		if (spanner_distance_within(ws, u, v, bound))
+			continue;
+
+		// add edge to spanner and to big graph
+		ws.adjacency[u].push_back(std::make_pair(v, potential_edge.length));
+		ws.adjacency[v].push_back(std::make_pair(u, potential_edge.length));
+		ws.distance_matrix[u * k + v] = potential_edge.length;
+		ws.distance_matrix[v * k + u] = potential_edge.length;
+
+		edges.push_back(WeightedEdge(nodes[u], nodes[v], static_cast<Weight>(mesh.weight(ch) * potential_edge.length)));
+	}
+}
+
+// stretch: stretch factor t of spanner graph 
+// yardstick: interval length for edge subdivisions
+void create_steiner_graph_improved_spanner(MutableGraph &graph, EdgeIndex &edges, Mesh &mesh, double stretch, double yardstick, int num_threads)
+{
+	create_steiner_graph_nodes_interval_scheme(graph, mesh, yardstick);
+
+	if (stretch == 0)
+	{	// no stretch allowed, build complete graph (faster)
+		std::cout << "adding graph edges (complete subgraphs) for " <<mesh.n_cells()  << " cells" << std::endl;
+	}
+	else
+	{
+		std::cout << "adding graph edges (spanner subgraphs) for " <<mesh.n_cells()  << " cells" << std::endl;
+	}
+
+	CellFeatures features(mesh, num_threads);
+
+	// the cells are independent and read the graph nodes only, so they are handed out one by one to the threads,
+	// which stay busy until all cells are done. each thread merges its edges into the shards of the edge index
+	// itself. the index keeps the minimal weight per edge in any merge order, so the graph is the same as
+	// a single thread builds.
+	int threads = std::min(worker_threads(num_threads), static_cast<int>(std::max<size_t>(mesh.n_cells(), 1)));
+
+	// enough shards that threads rarely wait for each other
+	size_t num_shards = 1;
+	while (threads > 1 && num_shards < 8 * static_cast<size_t>(threads))
+		num_shards *= 2;
+	edges.reset(num_shards);
+
+	std::vector<SpannerWorkspace> spanner_workspaces(threads);
+	std::vector<EdgeBuffer> edge_buffers(threads);
+	for (auto &buffer : edge_buffers)
+		buffer.reset(edges);
+
+	size_t n = mesh.n_cells();
+	std::atomic<size_t> processed(0);
+	size_t reported = 0;	// by thread 0 only
+
+	parallel_for(n, threads, [&](size_t c, int thread)
+	{
+		CellHandle ch(static_cast<int>(c));
+
+		if (stretch == 0)
+			complete_cell_edges(graph, mesh, features, ch, spanner_workspaces[thread], edge_buffers[thread]);
+		else
+			spanner_cell_edges(graph, mesh, features, ch, stretch, spanner_workspaces[thread], edge_buffers[thread]);
+
+		size_t done = ++processed;
+		if (thread == 0 && done >= reported + 65536)
 		{
-			auto vit = vertices(spanner);
-			for (auto v = u+1; v != vit.second; ++v)
-			{
-				double length = norm(graph[spanner[*u].original_node].point, graph[spanner[*v].original_node].point);
-//				assert(length > 0);
-				potential_edges.push_back(SpannerGraphEdge(*u, *v, length));
-			}
+			reported = done;
+			std::cout << "\r" << done << " cells processed" << std::flush;
 		}
+	});
+
+	parallel_for(edge_buffers.size(), threads, [&](size_t i, int)
+	{
+		edge_buffers[i].flush();
+	});
+
+	std::cout << "\r" << n << " cells processed" << std::endl;
+}
+
+const uint64_t EdgeTable::empty_key;
+
+void EdgeTable::grow()
+{
+	std::vector<uint64_t> old_keys(std::max<size_t>(1024, 2 * keys.size()), empty_key);
+	std::vector<Weight> old_weights(old_keys.size());
+	old_keys.swap(keys);
+	old_weights.swap(weights);
+
+	shift = 64;
+	for (size_t size = keys.size(); size > 1; size /= 2)
+		--shift;
+
+	for (size_t i = 0; i < old_keys.size(); ++i)
+	{
+		if (old_keys[i] == empty_key)
+			continue;
+
+		size_t j = slot(old_keys[i]);
+		while (keys[j] != empty_key)
+			j = (j + 1) & (keys.size() - 1);
+
+		keys[j] = old_keys[i];
+		weights[j] = old_weights[i];
+	}
+}
+
+void EdgeTable::clear()
+{
+	std::vector<uint64_t>().swap(keys);
+	std::vector<Weight>().swap(weights);
+	count = 0;
+	shift = 64;
+}
+
+void EdgeIndex::reset(size_t num_shards)
+{
+	assert(num_shards > 0 && (num_shards & (num_shards - 1)) == 0);
+	std::vector<EdgeTable>(num_shards).swap(shards);
+	std::vector<std::mutex>(num_shards).swap(locks);
+}
+
+bool EdgeIndex::add(size_t s, const std::vector<WeightedEdge> &edges, bool wait)
+{
+	std::unique_lock<std::mutex> lock(locks[s], std::defer_lock);
+	if (wait)
+		lock.lock();
+	else if (!lock.try_lock())
+		return false;
+
+	for (const auto &edge : edges)
+		shards[s].add(edge);
+	return true;
+}
+
+size_t EdgeIndex::size() const
+{
+	size_t count = 0;
+	for (const auto &table : shards)
+		count += table.size();
+	return count;
+}
+
+/////////////////////////////////////////////////////////////////////////////////////////////
+// the graph used for queries
+
+void freeze_graph(MutableGraph &mutable_graph, Graph &graph)
+{
+	size_t n = num_vertices(mutable_graph);
+
+	if (n > std::numeric_limits<GraphNode_descriptor>::max())
+	{
+		std::cerr << "freeze_graph: " << n << " graph nodes exceed the node number range" << std::endl;
+		exit(EXIT_FAILURE);
+	}
 
-		// sort edges by length
-		std::sort(potential_edges.begin(), potential_edges.end());
+	std::vector<GraphNode_descriptor> sources;
+	std::vector<GraphNode_descriptor> targets;
+	std::vector<GraphEdge> edge_properties;
+	sources.reserve(2 * num_edges(mutable_graph));
+	targets.reserve(2 * num_edges(mutable_graph));
+	edge_properties.reserve(2 * num_edges(mutable_graph));
 
-		// determine shortest path arleady in subgraph
-		for (auto potential_edge : potential_edges)
+	// the out edges of an undirected graph contain each edge once for both nodes,
+	// so walking the nodes in order yields both directions sorted by source
+	for (MutableGraphNode_descriptor u = 0; u < n; ++u)
+	{
+		MutableGraph::out_edge_iterator edgeIt, edgeEnd;
+		for (boost::tie(edgeIt, edgeEnd) = boost::out_edges(u, mutable_graph); edgeIt != edgeEnd; ++edgeIt)
 		{
-			std::vector<double> distances(num_vertices(spanner));
-			std::vector<SpannerGraphNode_descriptor> predecessors(num_vertices(spanner));
-
-			SpannerGraphNode_descriptor u = potential_edge.u;
-			SpannerGraphNode_descriptor v = potential_edge.v;
-
-			// this is the "unimproved" version with cubic runtime
-			boost::dijkstra_shortest_paths
-			(
-				spanner,
-				u,
-				boost::weight_map(get(&SpannerGraphEdge::length, spanner)).
-				distance_map(boost::make_iterator_property_map(distances.begin(), get(boost::vertex_index, graph))).
-				predecessor_map(boost::make_iterator_property_map(predecessors.begin(), get(boost::vertex_index, graph))).
-				distance_inf(std::numeric_limits<double>::infinity())
-			);
-
-			GraphNode_descriptor ou = spanner[u].original_node;
-			GraphNode_descriptor ov = spanner[v].original_node;
-
-			Point pu = graph[ou].point;
-			Point pv = graph[ov].point;
-
-			// add potential edge to graph iff its shorter that limit
-			if (distances[v] > (1 + stretch)*norm(pu,pv))
-			{
-				// add edge to spanner and to big graph
-				SpannerGraphEdge_descriptor spanner_edge = boost::add_edge(u, v, spanner ).first;
-				spanner[spanner_edge].length = potential_edge.length;
-				spanner[spanner_edge].u = potential_edge.u;
-				spanner[spanner_edge].v = potential_edge.v;
+			sources.push_back(static_cast<GraphNode_descriptor>(u));
+			targets.push_back(static_cast<GraphNode_descriptor>(boost::target(*edgeIt, mutable_graph)));
+			edge_properties.push_back(mutable_graph[*edgeIt]);
+		}
+	}
 
-				add_edge(graph, ou, ov, mesh.weight(ch) );
-			}
+	GraphNodes nodes;
+	std::swap(nodes, graph_nodes(mutable_graph));
+
+	// the copy is complete, release the memory before the csr arrays are allocated
+	mutable_graph.clear();
+
+	// the csr graph takes over targets and edge_properties, the sorted sources are left in place
+	graph = Graph(boost::construct_inplace_from_sources_and_targets, sources, targets, edge_properties, n);
+
+	std::swap(graph_nodes(graph), nodes);
+}
+
+void freeze_graph(MutableGraph &mutable_graph, EdgeIndex &edges, Graph &graph)
+{
+	size_t n = num_vertices(mutable_graph);
+
+	if (n > std::numeric_limits<GraphNode_descriptor>::max())
+	{
+		std::cerr << "freeze_graph: " << n << " graph nodes exceed the node number range" << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	// both directions of each edge sorted by source, a counting sort on the node degrees
+	std::vector<size_t> start(n + 1, 0);
+	edges.for_each([&](const WeightedEdge& edge)
+	{
+		++start[edge.u + 1];
+		++start[edge.v + 1];
+	});
+	for (size_t u = 0; u < n; ++u)
+		start[u + 1] += start[u];
+
+	// the staging arrays become the csr arrays: the graph takes over targets and edge_properties
+	// without a copy, only the sources (one node number per directed edge) come on top of the final graph.
+	std::vector<GraphNode_descriptor> sources(2 * edges.size());
+	std::vector<GraphNode_descriptor> targets(2 * edges.size());
+	std::vector<GraphEdge> edge_properties(2 * edges.size());
+
+	edges.for_each([&](const WeightedEdge& edge)
+	{
+		size_t i = start[edge.u]++;
+		sources[i] = edge.u;
+		targets[i] = edge.v;
+		edge_properties[i].weight = edge.weight;
+
+		size_t j = start[edge.v]++;
+		sources[j] = edge.v;
+		targets[j] = edge.u;
+		edge_properties[j].weight = edge.weight;
+	});
+	edges.clear();
+
+	// the hash table order depends on its capacity and insertion history, each row is sorted
+	// by target so that equally short paths are always resolved the same way.
+	// start[u] is the end of row u now.
+	std::vector<std::pair<GraphNode_descriptor, Weight>> row;
+	for (size_t u = 0, first = 0; u < n; first = start[u++])
+	{
+		row.clear();
+		for (size_t i = first; i < start[u]; ++i)
+			row.push_back(std::make_pair(targets[i], edge_properties[i].weight));
+
+		std::sort(row.begin(), row.end());
+
+		for (size_t i = first; i < start[u]; ++i)
+		{
+			targets[i] = row[i - first].first;
+			edge_properties[i].weight = row[i - first].second;
 		}
 	}
+	std::vector<size_t>().swap(start);
+	std::vector<std::pair<GraphNode_descriptor, Weight>>().swap(row);
+
+	// the in place histogram sort of the constructor leaves edges that are sorted by source already as they are
+	graph = Graph(boost::construct_inplace_from_sources_and_targets, sources, targets, edge_properties, n);
+
+	// the node arrays are taken over as they are
+	std::swap(graph_nodes(graph), graph_nodes(mutable_graph));
+
+	mutable_graph.clear();
+}
+
+void create_barycentric_steiner_points(Graph &graph, Mesh &mesh)
+{
+	MutableGraph mutable_graph;
+	create_barycentric_steiner_points(mutable_graph, mesh);
+	freeze_graph(mutable_graph, graph);
+}
+
+void create_surface_steiner_points(Graph &graph, Mesh &mesh)
+{
+	MutableGraph mutable_graph;
+	create_surface_steiner_points(mutable_graph, mesh);
+	freeze_graph(mutable_graph, graph);
+}
+
+void create_steiner_graph_improved_spanner(Graph &graph, Mesh &mesh, double stretch, double yardstick, int num_threads)
+{
+	MutableGraph mutable_graph;
+	EdgeIndex edges;
+	create_steiner_graph_improved_spanner(mutable_graph, edges, mesh, stretch, yardstick, num_threads);
+	freeze_graph(mutable_graph, edges, graph);
+}
+
+void create_steiner_graph_nodes(Graph &graph, Mesh &mesh, double yardstick)
+{
+	MutableGraph mutable_graph;
+	create_steiner_graph_nodes_interval_scheme(mutable_graph, mesh, yardstick);
+	freeze_graph(mutable_graph, graph);
 }
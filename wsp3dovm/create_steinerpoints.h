@@ -1,7 +1,146 @@
 #include "common.h"
 
+#include <mutex>
+
+// the graph is built edge by edge in a MutableGraph ...
+
+void create_barycentric_steiner_points(MutableGraph &graph, Mesh &mesh);
+
+void create_surface_steiner_points(MutableGraph &graph, Mesh &mesh);
+
+// undirected graph edge with u < v
+struct WeightedEdge
+{
+	WeightedEdge() {}
+	WeightedEdge(GraphNode_descriptor u, GraphNode_descriptor v, Weight weight)
+		: u(std::min(u, v)), v(std::max(u, v)), weight(weight)
+	{
+	}
+
+	GraphNode_descriptor u;
+	GraphNode_descriptor v;
+	Weight weight;
+};
+
+// one shard of the construction time index of the graph edges, an open addressing hash table keyed by
+// (min(u,v), max(u,v)). adding an edge that is present already keeps the minimal weight. this is amortized
+// O(1) per edge, boost::edge is linear in the node degree.
+class EdgeTable
+{
+public:
+	EdgeTable() : count(0), shift(64) {}
+
+	void add(const WeightedEdge &edge)
+	{
+		// keep the load factor below 1/2
+		if (2 * (count + 1) > keys.size())
+			grow();
+
+		uint64_t k = key(edge.u, edge.v);
+		for (size_t i = slot(k);; i = (i + 1) & (keys.size() - 1))
+		{
+			if (keys[i] == k)
+			{
+				// the edge runs across a face or mesh edge shared by cells, the cheaper cell wins
+				weights[i] = std::min(weights[i], edge.weight);
+				return;
+			}
+			if (keys[i] == empty_key)
+			{
+				keys[i] = k;
+				weights[i] = edge.weight;
+				++count;
+				return;
+			}
+		}
+	}
+
+	size_t size() const { return count; }
+
+	// calls f(edge) for all edges in table order
+	template <class Function>
+	void for_each(Function f) const
+	{
+		for (size_t i = 0; i < keys.size(); ++i)
+		{
+			if (keys[i] != empty_key)
+				f(WeightedEdge(static_cast<GraphNode_descriptor>(keys[i] >> 32), static_cast<GraphNode_descriptor>(keys[i]), weights[i]));
+		}
+	}
+
+	void clear();
+
+private:
+	static const uint64_t empty_key = ~uint64_t(0);	// u < v, so this is never a valid key
+
+	static uint64_t key(GraphNode_descriptor u, GraphNode_descriptor v) { return (uint64_t(u) << 32) | v; }
+
+	// fibonacci hashing, the high bits of the product are well mixed
+	size_t slot(uint64_t k) const { return static_cast<size_t>((k * 0x9E3779B97F4A7C15ull) >> shift); }
+
+	void grow();
+
+	std::vector<uint64_t> keys;
+	std::vector<Weight> weights;
+	size_t count;
+	int shift;	// 64 - log2(table size)
+};
+
+// construction time index of the graph edges, split into a power of two of shards by min(u,v),
+// so several threads merge edges into different shards at the same time.
+// the minimal weight of an edge does not depend on the order the edges are merged in.
+class EdgeIndex
+{
+public:
+	EdgeIndex() : shards(1), locks(1) {}
+
+	// drops all edges
+	void reset(size_t num_shards);
+
+	size_t num_shards() const { return shards.size(); }
+
+	size_t shard(const WeightedEdge &edge) const { return edge.u & (shards.size() - 1); }
+
+	void add(const WeightedEdge &edge) { shards[shard(edge)].add(edge); }
+
+	// adds edges of shard s, concurrent calls are serialized per shard.
+	// without wait, nothing is added and false returned if another thread holds the shard.
+	bool add(size_t s, const std::vector<WeightedEdge> &edges, bool wait);
+
+	size_t size() const;
+
+	// calls f(edge) for all edges, shard by shard in table order
+	template <class Function>
+	void for_each(Function f) const
+	{
+		for (const auto &table : shards)
+			table.for_each(f);
+	}
+
+	void clear() { reset(1); }
+
+private:
+	std::vector<EdgeTable> shards;
+	std::vector<std::mutex> locks;
+};
+
+// creates the graph nodes in graph and the edges in edges.
+// cells are processed on num_threads threads (0: all hardware threads), the graph does not depend on it
+void create_steiner_graph_improved_spanner(MutableGraph &graph, EdgeIndex &edges, Mesh &mesh, double stretch = 0, double yardstick=0, int num_threads=1);
+
+// ... and frozen into the compact graph for the queries, mutable_graph is cleared
+void freeze_graph(MutableGraph &mutable_graph, Graph &graph);
+
+// same for the nodes of mutable_graph and the edges in edges, both are cleared
+void freeze_graph(MutableGraph &mutable_graph, EdgeIndex &edges, Graph &graph);
+
+// build and freeze in one go
+
 void create_barycentric_steiner_points(Graph &graph, Mesh &mesh);
 
 void create_surface_steiner_points(Graph &graph, Mesh &mesh);
 
-void create_steiner_graph_improved_spanner(Graph &graph, Mesh &mesh, double stretch = 0, double yardstick=0);
+void create_steiner_graph_improved_spanner(Graph &graph, Mesh &mesh, double stretch = 0, double yardstick=0, int num_threads=1);
+
+// the nodes of create_steiner_graph_improved_spanner without any edges, for an ImplicitGraph
+void create_steiner_graph_nodes(Graph &graph, Mesh &mesh, double yardstick=0);
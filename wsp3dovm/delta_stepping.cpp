@@ -0,0 +1,292 @@
+#include "delta_stepping.h"
+#include "parallel.h"
+
+#include <atomic>
+#include <cmath>
+#include <queue>
+
+// frontier nodes and graph nodes are handed out to the workers in chunks of this size
+static const size_t chunk_size = 1024;
+
+double mean_edge_weight(const Graph& graph)
+{
+	if (num_edges(graph) == 0)
+		return 1;
+
+	double sum = 0;
+	Graph::edge_iterator edgeIt, edgeEnd;
+	for (boost::tie(edgeIt, edgeEnd) = boost::edges(graph); edgeIt != edgeEnd; ++edgeIt)
+		sum += graph[*edgeIt].weight;
+
+	return sum / num_edges(graph);
+}
+
+// smallest positive and largest edge weight, 0 if there are none
+static void edge_weight_range(const Graph& graph, double& min_positive, double& max)
+{
+	min_positive = std::numeric_limits<double>::infinity();
+	max = 0;
+
+	Graph::edge_iterator edgeIt, edgeEnd;
+	for (boost::tie(edgeIt, edgeEnd) = boost::edges(graph); edgeIt != edgeEnd; ++edgeIt)
+	{
+		double weight = graph[*edgeIt].weight;
+		if (weight > 0)
+			min_positive = std::min(min_positive, weight);
+		max = std::max(max, weight);
+	}
+
+	if (min_positive == std::numeric_limits<double>::infinity())
+		min_positive = 0;
+}
+
+double min_delta(const Graph& graph)
+{
+	double min_positive, max;
+	edge_weight_range(graph, min_positive, max);
+	return min_delta_fraction * min_positive;
+}
+
+// a queued node with the distance it was queued for. the entry is outdated if the node got a smaller distance since,
+// which queued it again, so a node is expanded once per distance it reaches, whatever bucket the entry ends up in.
+struct BucketEntry
+{
+	GraphNode_descriptor node;
+	double distance;
+};
+
+// orders a priority queue of entries by increasing distance
+struct FartherEntry
+{
+	bool operator()(const BucketEntry& a, const BucketEntry& b) const { return a.distance > b.distance; }
+};
+
+void delta_stepping(const Graph& graph, GraphNode_descriptor s, double delta, int num_threads, DijkstraWorkspace& workspace)
+{
+	// the implicit graph has no edges to scan in parallel
+	if (workspace.implicit)
+	{
+		dijkstra(graph, s, workspace);
+		return;
+	}
+
+	workspace.resize(graph);
+	workspace.reset();
+
+	// the threads are started once for all rounds
+	ThreadPool pool(num_threads);
+	num_threads = pool.size();
+
+	double min_positive_weight, max_weight;
+	edge_weight_range(graph, min_positive_weight, max_weight);
+
+	if (delta <= 0)
+		delta = mean_edge_weight(graph);
+	// callers reject smaller deltas, which would take as many rounds as there are distinct distances
+	delta = std::max(delta, min_delta_fraction * min_positive_weight);
+	if (!(delta > 0))
+		delta = 1;
+
+	// a node of the current bucket relaxes its neighbors into the next max_weight / delta + 1 buckets,
+	// so a cyclic array of buckets covers them. the array is limited for extreme weight ratios,
+	// nodes beyond it wait in far until the advancing array reaches their distance.
+	const double max_buckets = 4096;
+	size_t num_buckets = static_cast<size_t>(std::min(std::floor(max_weight / delta) + 2, max_buckets));
+
+	size_t n = num_vertices(graph);
+	const uint64_t infinity = ordered_bits(std::numeric_limits<double>::infinity());
+
+	std::vector<std::atomic<uint64_t>> distance(n);
+	pool.parallel_for_chunks(n, chunk_size, [&](size_t begin, size_t end, int)
+	{
+		for (size_t u = begin; u < end; ++u)
+			distance[u].store(infinity, std::memory_order_relaxed);
+	});
+	distance[s].store(ordered_bits(0), std::memory_order_relaxed);
+
+	// bins[thread][(current + i) % num_buckets] holds the nodes that thread improved to a distance
+	// in the i-th bucket from bucket_start on, far_bins[thread] those beyond the last bucket
+	std::vector<std::vector<std::vector<BucketEntry>>> bins(num_threads, std::vector<std::vector<BucketEntry>>(num_buckets));
+	std::vector<std::vector<BucketEntry>> far_bins(num_threads);
+	std::priority_queue<BucketEntry, std::vector<BucketEntry>, FartherEntry> far;
+	std::vector<size_t> expanded(num_threads, 0);
+
+	std::vector<BucketEntry> frontier(1, BucketEntry{ s, 0.0 });
+	size_t current = 0;
+	double bucket_start = 0;
+
+	while (!frontier.empty())
+	{
+		pool.parallel_for_chunks(frontier.size(), chunk_size, [&](size_t begin, size_t end, int thread)
+		{
+			std::vector<std::vector<BucketEntry>>& thread_bins = bins[thread];
+			size_t thread_expanded = 0;
+
+			for (size_t i = begin; i < end; ++i)
+			{
+				GraphNode_descriptor u = frontier[i].node;
+				double du = ordered_double(distance[u].load(std::memory_order_relaxed));
+				if (du < frontier[i].distance)
+					continue; // queued again for the smaller distance
+
+				++thread_expanded;
+
+				Graph::out_edge_iterator edgeIt, edgeEnd;
+				for (boost::tie(edgeIt, edgeEnd) = boost::out_edges(u, graph); edgeIt != edgeEnd; ++edgeIt)
+				{
+					GraphNode_descriptor v = boost::target(*edgeIt, graph);
+					double d = du + graph[*edgeIt].weight;
+					if (atomic_min(distance[v], ordered_bits(d)))
+					{
+						// buckets are counted from the current one, rounding must not move a node below it
+						double offset = std::max(std::floor((d - bucket_start) / delta), 0.0);
+						if (offset < num_buckets)
+							thread_bins[(current + static_cast<size_t>(offset)) % num_buckets].push_back(BucketEntry{ v, d });
+						else
+							far_bins[thread].push_back(BucketEntry{ v, d });
+					}
+				}
+			}
+
+			expanded[thread] += thread_expanded;
+		});
+
+		for (auto& thread_far : far_bins)
+		{
+			for (const BucketEntry& entry : thread_far)
+				far.push(entry);
+			thread_far.clear();
+		}
+
+		auto outdated = [&](const BucketEntry& entry)
+		{
+			return ordered_double(distance[entry.node].load(std::memory_order_relaxed)) < entry.distance;
+		};
+
+		// the lowest non-empty bucket of all threads is the next frontier, this may be the current bucket again
+		size_t next = num_buckets;
+		for (auto& thread_bins : bins)
+		{
+			for (size_t i = 0; i < next; ++i)
+			{
+				if (!thread_bins[(current + i) % num_buckets].empty())
+				{
+					next = i;
+					break;
+				}
+			}
+		}
+
+		if (next == num_buckets)
+		{
+			// all buckets are empty, the array starts over from the smallest far distance
+			while (!far.empty() && outdated(far.top()))
+				far.pop();
+			if (far.empty())
+				break;
+
+			current = 0;
+			bucket_start = far.top().distance;
+		}
+		else
+		{
+			current = (current + next) % num_buckets;
+			bucket_start += next * delta;
+		}
+
+		// the far entries the array covers now move to their buckets, before any later bucket is expanded
+		while (!far.empty())
+		{
+			BucketEntry entry = far.top();
+			double offset = std::max(std::floor((entry.distance - bucket_start) / delta), 0.0);
+			if (offset >= num_buckets)
+				break;
+
+			far.pop();
+			if (!outdated(entry))
+				bins[0][(current + static_cast<size_t>(offset)) % num_buckets].push_back(entry);
+		}
+
+		frontier.clear();
+		for (auto& thread_bins : bins)
+		{
+			frontier.insert(frontier.end(), thread_bins[current].begin(), thread_bins[current].end());
+			thread_bins[current].clear();
+		}
+	}
+
+	// predecessors are taken from the final distances: v hangs below a neighbor u with distance[u] + weight == distance[v].
+	// this is exact, the final distance of v was computed by the same addition from the final distance of u.
+	// requiring distance[u] < distance[v] keeps the predecessor chains acyclic.
+	std::vector<unsigned char> has_predecessor(n, 0);
+	has_predecessor[s] = 1;
+
+	pool.parallel_for_chunks(n, chunk_size, [&](size_t begin, size_t end, int)
+	{
+		for (GraphNode_descriptor v = static_cast<GraphNode_descriptor>(begin); v < end; ++v)
+		{
+			double dv = ordered_double(distance[v].load(std::memory_order_relaxed));
+			workspace.distance[v] = dv;
+
+			if (v == s || dv == std::numeric_limits<double>::infinity())
+				continue;
+
+			Graph::out_edge_iterator edgeIt, edgeEnd;
+			for (boost::tie(edgeIt, edgeEnd) = boost::out_edges(v, graph); edgeIt != edgeEnd; ++edgeIt)
+			{
+				GraphNode_descriptor u = boost::target(*edgeIt, graph);
+				double du = ordered_double(distance[u].load(std::memory_order_relaxed));
+
+				if (du < dv && du + graph[*edgeIt].weight == dv)
+				{
+					workspace.predecessor[v] = u;
+					has_predecessor[v] = 1;
+					break;
+				}
+			}
+		}
+	});
+
+	// with zero weight edges, some nodes have tight neighbors at the same distance only.
+	// these are attached to such a neighbor that has a predecessor already, until none is left.
+	std::vector<GraphNode_descriptor> pending;
+	for (GraphNode_descriptor v = 0; v < n; ++v)
+	{
+		if (!has_predecessor[v] && workspace.distance[v] != std::numeric_limits<double>::infinity())
+			pending.push_back(v);
+	}
+
+	while (!pending.empty())
+	{
+		size_t remaining = 0;
+		for (GraphNode_descriptor v : pending)
+		{
+			Graph::out_edge_iterator edgeIt, edgeEnd;
+			for (boost::tie(edgeIt, edgeEnd) = boost::out_edges(v, graph); edgeIt != edgeEnd; ++edgeIt)
+			{
+				GraphNode_descriptor u = boost::target(*edgeIt, graph);
+				if (has_predecessor[u] && workspace.distance[u] + graph[*edgeIt].weight == workspace.distance[v])
+				{
+					workspace.predecessor[v] = u;
+					has_predecessor[v] = 1;
+					break;
+				}
+			}
+
+			if (!has_predecessor[v])
+				pending[remaining++] = v;
+		}
+
+		if (remaining == pending.size())
+			break; // cannot happen for an undirected graph, but never loop forever
+		pending.resize(remaining);
+	}
+
+	workspace.settled = 0;
+	for (size_t e : expanded)
+		workspace.settled += e;
+
+	// all distances and predecessors were written
+	workspace.touched.clear();
+	workspace.all_touched = true;
+}
@@ -0,0 +1,25 @@
+#ifndef DELTA_STEPPING_H
+#define DELTA_STEPPING_H
+
+#include "common.h"
+#include "dijkstra.h"
+
+// mean edge weight of the graph, a reasonable bucket width for delta_stepping
+double mean_edge_weight(const Graph& graph);
+
+// bucket widths below this fraction of the smallest positive edge weight are rejected
+const double min_delta_fraction = 1e-3;
+
+// the smallest bucket width for delta_stepping, 0 if the graph has no positive edge weights
+double min_delta(const Graph& graph);
+
+// full single source shortest path tree rooted at s, computed by delta-stepping on num_threads workers.
+// nodes are processed in buckets of width delta (0: mean_edge_weight), all nodes of a bucket in parallel
+// on one pool of threads. the buckets are a cyclic array spanning the largest edge weight, delta is raised to min_delta.
+// the graph must be undirected. the results in workspace can be used exactly like those of dijkstra,
+// the distances are equal to those of dijkstra, on ties the predecessors may differ.
+// settled counts the node expansions, which exceeds the number of reachable nodes for large deltas.
+// with an implicit graph in the workspace, this falls back to dijkstra.
+void delta_stepping(const Graph& graph, GraphNode_descriptor s, double delta, int num_threads, DijkstraWorkspace& workspace);
+
+#endif
@@ -0,0 +1,584 @@
+#include "dijkstra.h"
+#include "implicit_graph.h"
+
+#include <cstring>
+#include <queue>
+
+bool parse_query_algorithm(const std::string& name, QueryAlgorithm& algorithm)
+{
+	if (name == "dijkstra")
+		algorithm = QUERY_DIJKSTRA;
+	else if (name == "bidirectional")
+		algorithm = QUERY_BIDIRECTIONAL;
+	else if (name == "astar")
+		algorithm = QUERY_ASTAR;
+	else
+		return false;
+
+	return true;
+}
+
+const char* query_algorithm_name(QueryAlgorithm algorithm)
+{
+	switch (algorithm)
+	{
+	case QUERY_DIJKSTRA:		return "dijkstra";
+	case QUERY_BIDIRECTIONAL:	return "bidirectional";
+	case QUERY_ASTAR:			return "astar";
+	}
+	return "unknown";
+}
+
+bool parse_priority_queue(const std::string& name, PriorityQueue& queue)
+{
+	if (name == "boost")
+		queue = QUEUE_BOOST;
+	else if (name == "binary")
+		queue = QUEUE_BINARY;
+	else if (name == "radix")
+		queue = QUEUE_RADIX;
+	else
+		return false;
+
+	return true;
+}
+
+const char* priority_queue_name(PriorityQueue queue)
+{
+	switch (queue)
+	{
+	case QUEUE_BOOST:	return "boost";
+	case QUEUE_BINARY:	return "binary";
+	case QUEUE_RADIX:	return "radix";
+	}
+	return "unknown";
+}
+
+typedef std::pair<double, GraphNode_descriptor> QueueEntry;
+
+// lazy deletion: a node is pushed again when its distance decreases,
+// outdated entries are skipped by the search when they are popped
+class BinaryHeap
+{
+public:
+	bool empty() const { return heap.empty(); }
+
+	void push(double key, GraphNode_descriptor u) { heap.push(QueueEntry(key, u)); }
+
+	QueueEntry pop()
+	{
+		QueueEntry entry = heap.top();
+		heap.pop();
+		return entry;
+	}
+
+private:
+	std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>> heap;
+};
+
+// monotone priority queue: no key may be pushed below the last popped one, as in dijkstra.
+// the bits of non-negative doubles compare like the doubles, so they serve as integer keys.
+// bucket i > 0 holds the keys whose highest bit different from the last popped key is bit i-1,
+// each entry moves to a lower bucket at most 64 times, independent of the queue size.
+class RadixHeap
+{
+public:
+	RadixHeap() : last(0), size(0) {}
+
+	bool empty() const { return size == 0; }
+
+	void push(double key, GraphNode_descriptor u)
+	{
+		uint64_t bits = key_bits(key);
+		buckets[bucket(bits)].push_back(Entry(bits, u));
+		++size;
+	}
+
+	QueueEntry pop()
+	{
+		if (buckets[0].empty())
+		{
+			int i = 1;
+			while (buckets[i].empty())
+				++i;
+
+			// the minimum of the first non-empty bucket becomes the last key,
+			// then all entries of this bucket go to lower buckets
+			last = buckets[i][0].first;
+			for (const Entry& entry : buckets[i])
+				last = std::min(last, entry.first);
+
+			for (const Entry& entry : buckets[i])
+				buckets[bucket(entry.first)].push_back(entry);
+			buckets[i].clear();
+		}
+
+		Entry entry = buckets[0].back();
+		buckets[0].pop_back();
+		--size;
+
+		double key;
+		std::memcpy(&key, &entry.first, sizeof(key));
+		return QueueEntry(key, entry.second);
+	}
+
+private:
+	typedef std::pair<uint64_t, GraphNode_descriptor> Entry;
+
+	static uint64_t key_bits(double key)
+	{
+		uint64_t bits;
+		std::memcpy(&bits, &key, sizeof(bits));
+		return bits;
+	}
+
+	// number of significant bits of the difference to the last key, 0 for the last key itself
+	int bucket(uint64_t bits) const
+	{
+		uint64_t diff = bits ^ last;
+		int i = 0;
+		for (int shift = 32; shift > 0; shift /= 2)
+		{
+			if (diff >> shift)
+			{
+				diff >>= shift;
+				i += shift;
+			}
+		}
+		return i + static_cast<int>(diff);
+	}
+
+	std::vector<Entry> buckets[65];
+	uint64_t last;
+	size_t size;
+};
+
+// out edges of the frozen graph in the form of ImplicitGraph::for_each_neighbor
+struct GraphNeighbors
+{
+	GraphNeighbors(const Graph& graph) : graph(graph) {}
+
+	template <class Function>
+	void for_each_neighbor(GraphNode_descriptor u, Function f) const
+	{
+		Graph::out_edge_iterator edgeIt, edgeEnd;
+		for (boost::tie(edgeIt, edgeEnd) = boost::out_edges(u, graph); edgeIt != edgeEnd; ++edgeIt)
+			f(boost::target(*edgeIt, graph), graph[*edgeIt].weight);
+	}
+
+	const Graph& graph;
+};
+
+// dijkstra from all (distinct) sources, stops when all sorted, distinct targets are settled
+// or runs until all reachable nodes are settled if there are no targets.
+// leaves the workspace in the same state as the searches of boost with the corresponding visitor.
+template <class Queue, class Neighbors>
+static void lazy_dijkstra(const Neighbors& neighbors, const std::vector<GraphNode_descriptor>& sources, const std::vector<GraphNode_descriptor>& targets, DijkstraWorkspace& workspace)
+{
+	const double infinity = std::numeric_limits<double>::infinity();
+
+	Queue queue;
+	size_t remaining = targets.size();
+
+	for (auto s : sources)
+	{
+		workspace.distance[s] = 0;
+		workspace.touched.push_back(s);
+		queue.push(0, s);
+	}
+
+	while (!queue.empty())
+	{
+		QueueEntry entry = queue.pop();
+
+		GraphNode_descriptor u = entry.second;
+		if (workspace.color[u] == boost::black_color)
+			continue;
+		workspace.color[u] = boost::black_color;
+		++workspace.settled;
+
+		if (!targets.empty() && std::binary_search(targets.begin(), targets.end(), u) && --remaining == 0)
+			return;
+
+		neighbors.for_each_neighbor(u, [&](GraphNode_descriptor v, double weight)
+		{
+			double d = entry.first + weight;
+
+			if (d < workspace.distance[v])
+			{
+				if (workspace.distance[v] == infinity)
+					workspace.touched.push_back(v);
+
+				workspace.distance[v] = d;
+				workspace.predecessor[v] = u;
+				queue.push(d, v);
+			}
+		});
+	}
+}
+
+// runs the search with the priority queue of the workspace, false for QUEUE_BOOST on the frozen graph
+static bool lazy_dijkstra(const Graph& graph, const std::vector<GraphNode_descriptor>& sources, const std::vector<GraphNode_descriptor>& targets, DijkstraWorkspace& workspace)
+{
+	if (workspace.implicit)
+	{
+		if (workspace.queue == QUEUE_RADIX)
+			lazy_dijkstra<RadixHeap>(*workspace.implicit, sources, targets, workspace);
+		else
+			lazy_dijkstra<BinaryHeap>(*workspace.implicit, sources, targets, workspace);
+		return true;
+	}
+
+	switch (workspace.queue)
+	{
+	case QUEUE_BINARY:
+		lazy_dijkstra<BinaryHeap>(GraphNeighbors(graph), sources, targets, workspace);
+		return true;
+	case QUEUE_RADIX:
+		lazy_dijkstra<RadixHeap>(GraphNeighbors(graph), sources, targets, workspace);
+		return true;
+	default:
+		return false;
+	}
+}
+
+void DijkstraWorkspace::resize(const Graph& graph)
+{
+	size_t n = num_vertices(graph);
+	if (distance.size() == n)
+		return;
+
+	distance.assign(n, std::numeric_limits<double>::infinity());
+	predecessor.resize(n);
+	for (size_t u = 0; u < n; ++u)
+		predecessor[u] = u;
+	color.assign(n, boost::white_color);
+	index_in_heap.resize(n);
+	touched.clear();
+	all_touched = false;
+}
+
+void DijkstraWorkspace::resize_backward()
+{
+	size_t n = distance.size();
+	if (distance_backward.size() == n)
+		return;
+
+	distance_backward.assign(n, std::numeric_limits<double>::infinity());
+	predecessor_backward.resize(n);
+	for (size_t u = 0; u < n; ++u)
+		predecessor_backward[u] = u;
+	color_backward.assign(n, boost::white_color);
+}
+
+void DijkstraWorkspace::resize_astar()
+{
+	size_t n = distance.size();
+	if (cost.size() == n)
+		return;
+
+	cost.assign(n, std::numeric_limits<double>::infinity());
+}
+
+void DijkstraWorkspace::reset()
+{
+	bool backward = !distance_backward.empty();
+
+	if (all_touched)
+	{
+		std::fill(distance.begin(), distance.end(), std::numeric_limits<double>::infinity());
+		for (size_t u = 0; u < predecessor.size(); ++u)
+			predecessor[u] = u;
+		std::fill(color.begin(), color.end(), boost::white_color);
+	}
+	else
+	{
+		for (auto u : touched)
+		{
+			distance[u] = std::numeric_limits<double>::infinity();
+			predecessor[u] = u;
+			color[u] = boost::white_color;
+		}
+	}
+
+	// a full search does not use the backward buffers, so these are never all touched
+	if (backward)
+	{
+		for (auto u : touched)
+		{
+			distance_backward[u] = std::numeric_limits<double>::infinity();
+			predecessor_backward[u] = u;
+			color_backward[u] = boost::white_color;
+		}
+	}
+
+	// same for the cost of A*
+	if (!cost.empty())
+	{
+		for (auto u : touched)
+			cost[u] = std::numeric_limits<double>::infinity();
+	}
+	touched.clear();
+	all_touched = false;
+	settled = 0;
+}
+
+void dijkstra(const Graph& graph, GraphNode_descriptor s, DijkstraWorkspace& workspace)
+{
+	workspace.resize(graph);
+
+	// the backward and A* buffers are not initialized by dijkstra_shortest_paths
+	workspace.reset();
+
+	if (lazy_dijkstra(graph, std::vector<GraphNode_descriptor>(1, s), std::vector<GraphNode_descriptor>(), workspace))
+		return;
+
+	// dijkstra_shortest_paths initializes all nodes itself
+	boost::dijkstra_shortest_paths
+	(
+		graph,
+		s,
+		boost::weight_map(get(&GraphEdge::weight, graph)).
+		distance_map(boost::make_iterator_property_map(workspace.distance.begin(), get(boost::vertex_index, graph))).
+		predecessor_map(boost::make_iterator_property_map(workspace.predecessor.begin(), get(boost::vertex_index, graph))).
+		distance_inf(std::numeric_limits<double>::infinity())
+	);
+
+	// a full tree settles every reachable node
+	workspace.settled = std::count_if(workspace.distance.begin(), workspace.distance.end(), [](double d) { return d < std::numeric_limits<double>::infinity(); });
+
+	workspace.touched.clear();
+	workspace.all_touched = true;
+}
+
+// dijkstra_shortest_paths_no_init with the index-in-heap map of the workspace.
+// boost would allocate and fill one of num_vertices entries per call, i.e. O(n) per s-t query.
+// the heap reads only the entries of nodes it pushed itself (the color map tells which),
+// so the stale entries of earlier queries need no reset.
+template <class SourceIterator, class Visitor>
+static void boost_dijkstra_no_init(const Graph& graph, SourceIterator s_begin, SourceIterator s_end, Visitor visitor, DijkstraWorkspace& workspace)
+{
+	auto index = get(boost::vertex_index, graph);
+	auto predecessor = boost::make_iterator_property_map(workspace.predecessor.begin(), index);
+	auto distance = boost::make_iterator_property_map(workspace.distance.begin(), index);
+	auto index_in_heap = boost::make_iterator_property_map(workspace.index_in_heap.begin(), index);
+	auto weight = get(&GraphEdge::weight, graph);
+	std::less<double> compare;
+	boost::closed_plus<double> combine(std::numeric_limits<double>::infinity());
+
+	typedef boost::d_ary_heap_indirect<GraphNode_descriptor, 4, decltype(index_in_heap), decltype(distance), std::less<double>> Queue;
+	Queue queue(distance, index_in_heap, compare);
+
+	boost::detail::dijkstra_bfs_visitor<Visitor, Queue, decltype(weight), decltype(predecessor), decltype(distance), boost::closed_plus<double>, std::less<double>>
+		bfs_visitor(visitor, queue, weight, predecessor, distance, combine, compare, 0.0);
+
+	boost::breadth_first_visit(graph, s_begin, s_end, queue, bfs_visitor, boost::make_iterator_property_map(workspace.color.begin(), index));
+}
+
+void dijkstra_to(const Graph& graph, GraphNode_descriptor s, GraphNode_descriptor t, DijkstraWorkspace& workspace)
+{
+	workspace.resize(graph);
+	workspace.reset();
+
+	if (lazy_dijkstra(graph, std::vector<GraphNode_descriptor>(1, s), std::vector<GraphNode_descriptor>(1, t), workspace))
+		return;
+
+	// the _no_init variant expects the source to be initialized by the caller
+	workspace.distance[s] = 0;
+
+	try
+	{
+		boost_dijkstra_no_init(graph, &s, &s + 1, point_to_point_visitor(t, workspace.touched, workspace.settled), workspace);
+	}
+	catch (const target_settled&)
+	{
+		// regular end of a point-to-point query
+	}
+}
+
+void bidirectional_dijkstra(const Graph& graph, GraphNode_descriptor s, GraphNode_descriptor t, DijkstraWorkspace& workspace)
+{
+	if (workspace.implicit)
+	{
+		dijkstra_to(graph, s, t, workspace);
+		return;
+	}
+
+	workspace.resize(graph);
+	workspace.resize_backward();
+	workspace.reset();
+
+	const double infinity = std::numeric_limits<double>::infinity();
+
+	// lazy deletion: outdated queue entries are skipped when they are popped
+	typedef std::priority_queue<QueueEntry, std::vector<QueueEntry>, std::greater<QueueEntry>> Queue;
+
+	Queue forward_queue;
+	Queue backward_queue;
+
+	std::vector<GraphNode_descriptor>& touched = workspace.touched;
+
+	workspace.distance[s] = 0;
+	forward_queue.push(QueueEntry(0, s));
+	touched.push_back(s);
+
+	workspace.distance_backward[t] = 0;
+	backward_queue.push(QueueEntry(0, t));
+	if (t != s)
+		touched.push_back(t);
+
+	// length of the best s-t path seen so far and the node where its two halves meet
+	double best = (s == t) ? 0 : infinity;
+	GraphNode_descriptor meet = s;
+
+	while (!forward_queue.empty() && !backward_queue.empty())
+	{
+		// no path through unsettled nodes can be shorter than both radii together
+		if (forward_queue.top().first + backward_queue.top().first >= best)
+			break;
+
+		// advance the side with the smaller radius, this keeps both balls about the same size
+		bool forward = forward_queue.top().first <= backward_queue.top().first;
+
+		Queue& queue = forward ? forward_queue : backward_queue;
+		std::vector<double>& distance = forward ? workspace.distance : workspace.distance_backward;
+		std::vector<GraphNode_descriptor>& predecessor = forward ? workspace.predecessor : workspace.predecessor_backward;
+		std::vector<boost::default_color_type>& color = forward ? workspace.color : workspace.color_backward;
+		const std::vector<double>& other_distance = forward ? workspace.distance_backward : workspace.distance;
+
+		QueueEntry entry = queue.top();
+		queue.pop();
+
+		GraphNode_descriptor u = entry.second;
+		if (color[u] == boost::black_color)
+			continue;
+		color[u] = boost::black_color;
+		++workspace.settled;
+
+		Graph::out_edge_iterator edgeIt, edgeEnd;
+		for (boost::tie(edgeIt, edgeEnd) = boost::out_edges(u, graph); edgeIt != edgeEnd; ++edgeIt)
+		{
+			GraphNode_descriptor v = boost::target(*edgeIt, graph);
+			double d = entry.first + graph[*edgeIt].weight;
+
+			if (d < distance[v])
+			{
+				if (distance[v] == infinity && other_distance[v] == infinity)
+					touched.push_back(v);
+
+				distance[v] = d;
+				predecessor[v] = u;
+				queue.push(QueueEntry(d, v));
+
+				if (d + other_distance[v] < best)
+				{
+					best = d + other_distance[v];
+					meet = v;
+				}
+			}
+		}
+	}
+
+	if (best == infinity)
+		return; // t is unreachable, distance[t] stays infinite
+
+	// append the backward half to the forward predecessor chain: s -> ... -> meet -> ... -> t
+	for (GraphNode_descriptor x = meet; x != t; )
+	{
+		GraphNode_descriptor y = workspace.predecessor_backward[x];
+		workspace.predecessor[y] = x;
+		workspace.distance[y] = best - workspace.distance_backward[y];
+		x = y;
+	}
+}
+
+void astar(const Graph& graph, GraphNode_descriptor s, GraphNode_descriptor t, DijkstraWorkspace& workspace)
+{
+	if (workspace.implicit)
+	{
+		dijkstra_to(graph, s, t, workspace);
+		return;
+	}
+
+	workspace.resize(graph);
+	workspace.resize_astar();
+	workspace.reset();
+
+	euclidean_heuristic heuristic(graph, t, workspace.min_weight);
+
+	// the _no_init variant expects the source to be initialized by the caller
+	workspace.distance[s] = 0;
+	workspace.cost[s] = heuristic(s);
+
+	try
+	{
+		boost::astar_search_no_init
+		(
+			graph,
+			s,
+			heuristic,
+			astar_point_to_point_visitor(t, workspace.touched, workspace.settled),
+			boost::make_iterator_property_map(workspace.predecessor.begin(), get(boost::vertex_index, graph)),
+			boost::make_iterator_property_map(workspace.cost.begin(), get(boost::vertex_index, graph)),
+			boost::make_iterator_property_map(workspace.distance.begin(), get(boost::vertex_index, graph)),
+			get(&GraphEdge::weight, graph),
+			boost::make_iterator_property_map(workspace.color.begin(), get(boost::vertex_index, graph)),
+			get(boost::vertex_index, graph),
+			std::less<double>(),
+			boost::closed_plus<double>(std::numeric_limits<double>::infinity()),
+			std::numeric_limits<double>::infinity(),
+			0.0
+		);
+	}
+	catch (const target_settled&)
+	{
+		// regular end of a point-to-point query
+	}
+}
+
+void shortest_path_query(const Graph& graph, GraphNode_descriptor s, GraphNode_descriptor t, QueryAlgorithm algorithm, DijkstraWorkspace& workspace)
+{
+	switch (algorithm)
+	{
+	case QUERY_DIJKSTRA:
+		dijkstra_to(graph, s, t, workspace);
+		break;
+	case QUERY_BIDIRECTIONAL:
+		bidirectional_dijkstra(graph, s, t, workspace);
+		break;
+	case QUERY_ASTAR:
+		astar(graph, s, t, workspace);
+		break;
+	}
+}
+
+void dijkstra_to_many(const Graph& graph, const std::vector<GraphNode_descriptor>& sources, const std::vector<GraphNode_descriptor>& targets, DijkstraWorkspace& workspace)
+{
+	workspace.resize(graph);
+	workspace.reset();
+
+	// duplicates would be discovered twice resp. counted twice by the visitor
+	std::vector<GraphNode_descriptor> distinct_sources(sources);
+	std::sort(distinct_sources.begin(), distinct_sources.end());
+	distinct_sources.erase(std::unique(distinct_sources.begin(), distinct_sources.end()), distinct_sources.end());
+
+	std::vector<GraphNode_descriptor> distinct_targets(targets);
+	std::sort(distinct_targets.begin(), distinct_targets.end());
+	distinct_targets.erase(std::unique(distinct_targets.begin(), distinct_targets.end()), distinct_targets.end());
+
+	if (lazy_dijkstra(graph, distinct_sources, distinct_targets, workspace))
+		return;
+
+	// the _no_init variant expects the sources to be initialized by the caller
+	for (auto s : distinct_sources)
+		workspace.distance[s] = 0;
+
+	try
+	{
+		boost_dijkstra_no_init(graph, distinct_sources.begin(), distinct_sources.end(), targets_visitor(distinct_targets, workspace.touched, workspace.settled), workspace);
+	}
+	catch (const target_settled&)
+	{
+		// regular end of a one-to-many query
+	}
+}
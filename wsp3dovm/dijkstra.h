@@ -0,0 +1,228 @@
+#ifndef DIJKSTRA_H
+#define DIJKSTRA_H
+
+#include "common.h"
+
+#include <boost/graph/astar_search.hpp>
+
+#include <algorithm>
+#include <limits>
+
+class ImplicitGraph;
+
+// priority queues of the dijkstra searches
+enum PriorityQueue
+{
+	QUEUE_BOOST,	// d-ary heap with decrease-key of boost::dijkstra_shortest_paths
+	QUEUE_BINARY,	// binary heap without decrease-key, outdated entries are skipped
+	QUEUE_RADIX		// radix heap on the bits of the distances, these are monotone in dijkstra
+};
+
+// parse a priority queue name as given on the command line, returns false for unknown names
+bool parse_priority_queue(const std::string& name, PriorityQueue& queue);
+
+const char* priority_queue_name(PriorityQueue queue);
+
+// scratch buffers for shortest path queries on one graph.
+// each worker thread owns one, so queries can run concurrently on the shared (read-only) graph.
+// between queries, all nodes are kept at distance infinity, predecessor itself and color white,
+// a point-to-point query restores only the nodes it touched and keeps the heap index map of boost
+// across queries, so it does not pay O(n) per query.
+struct DijkstraWorkspace
+{
+	DijkstraWorkspace() : all_touched(false), settled(0), min_weight(0), queue(QUEUE_BOOST), implicit(0) {}
+	DijkstraWorkspace(const Graph& graph) : all_touched(false), settled(0), min_weight(0), queue(QUEUE_BOOST), implicit(0) { resize(graph); }
+
+	// allocates buffers for graph, nothing is done if the size is right already
+	void resize(const Graph& graph);
+
+	// allocates the buffers of the backward search, used by bidirectional queries only
+	void resize_backward();
+
+	// allocates the estimated total cost buffer, used by A* queries only
+	void resize_astar();
+
+	// restores the initial state of all nodes touched by the last query
+	void reset();
+
+	std::vector<double> distance;
+	std::vector<GraphNode_descriptor> predecessor;
+	std::vector<boost::default_color_type> color;
+	std::vector<size_t> index_in_heap;			// position in the d-ary heap of boost, valid for gray nodes only
+
+	// backward search from the target in bidirectional queries
+	std::vector<double> distance_backward;
+	std::vector<GraphNode_descriptor> predecessor_backward;
+	std::vector<boost::default_color_type> color_backward;
+
+	// distance plus heuristic estimate of the remaining distance in A* queries
+	std::vector<double> cost;
+
+	std::vector<GraphNode_descriptor> touched;	// nodes discovered by the last query
+	bool all_touched;							// last query was a full search, reset all nodes
+
+	size_t settled;								// nodes settled by the last s-t query, the measure for the search effort
+
+	// lower bound for edge weight per edge length, i.e. the minimal cell weight.
+	// used by the A* heuristic, 0 turns A* into plain Dijkstra.
+	double min_weight;
+
+	// priority queue of dijkstra, dijkstra_to and dijkstra_to_many.
+	// bidirectional queries always use a binary heap, A* queries the one of boost.
+	PriorityQueue queue;
+
+	// if set, the searches generate the neighbours by implicit and use the graph for its nodes only.
+	// all queries run as dijkstra then, with a binary heap for QUEUE_BOOST.
+	const ImplicitGraph* implicit;
+};
+
+// search strategies for s-t queries
+enum QueryAlgorithm
+{
+	QUERY_DIJKSTRA,			// single sided, stops when t is settled
+	QUERY_BIDIRECTIONAL,	// searches from s and t simultaneously until they meet
+	QUERY_ASTAR				// goal directed by the weighted euclidean distance to t
+};
+
+// parse an algorithm name as given on the command line, returns false for unknown names
+bool parse_query_algorithm(const std::string& name, QueryAlgorithm& algorithm);
+
+const char* query_algorithm_name(QueryAlgorithm algorithm);
+
+// thrown by a visitor to stop the search when the target node is settled
+struct target_settled {};
+
+// visitor for point-to-point queries: records the touched nodes and stops at the target
+class point_to_point_visitor : public boost::default_dijkstra_visitor
+{
+public:
+	point_to_point_visitor(GraphNode_descriptor target, std::vector<GraphNode_descriptor>& touched, size_t& settled)
+		: target(target), touched(touched), settled(settled)
+	{
+	}
+
+	void discover_vertex(GraphNode_descriptor u, const Graph&)
+	{
+		touched.push_back(u);
+	}
+
+	void examine_vertex(GraphNode_descriptor u, const Graph&)
+	{
+		++settled;
+		if (u == target)
+			throw target_settled();
+	}
+
+private:
+	GraphNode_descriptor target;
+	std::vector<GraphNode_descriptor>& touched;
+	size_t& settled;
+};
+
+// same as point_to_point_visitor, but for astar_search
+class astar_point_to_point_visitor : public boost::default_astar_visitor
+{
+public:
+	astar_point_to_point_visitor(GraphNode_descriptor target, std::vector<GraphNode_descriptor>& touched, size_t& settled)
+		: target(target), touched(touched), settled(settled)
+	{
+	}
+
+	void discover_vertex(GraphNode_descriptor u, const Graph&)
+	{
+		touched.push_back(u);
+	}
+
+	void examine_vertex(GraphNode_descriptor u, const Graph&)
+	{
+		++settled;
+		if (u == target)
+			throw target_settled();
+	}
+
+private:
+	GraphNode_descriptor target;
+	std::vector<GraphNode_descriptor>& touched;
+	size_t& settled;
+};
+
+// same as point_to_point_visitor, but stops when all of the sorted, distinct targets are settled.
+// no targets means no stop, the search runs until all reachable nodes are settled.
+class targets_visitor : public boost::default_dijkstra_visitor
+{
+public:
+	targets_visitor(const std::vector<GraphNode_descriptor>& targets, std::vector<GraphNode_descriptor>& touched, size_t& settled)
+		: targets(targets), remaining(targets.size()), touched(touched), settled(settled)
+	{
+	}
+
+	void discover_vertex(GraphNode_descriptor u, const Graph&)
+	{
+		touched.push_back(u);
+	}
+
+	void examine_vertex(GraphNode_descriptor u, const Graph&)
+	{
+		++settled;
+		if (std::binary_search(targets.begin(), targets.end(), u) && --remaining == 0)
+			throw target_settled();
+	}
+
+private:
+	const std::vector<GraphNode_descriptor>& targets;
+	size_t remaining;
+	std::vector<GraphNode_descriptor>& touched;
+	size_t& settled;
+};
+
+// each edge weight is at least its euclidean length times the minimal cell weight,
+// so min_weight times the euclidean distance to the target never overestimates.
+// the heuristic is also consistent, so (up to rounding) A* settles each node at most once.
+// the edge weights are rounded to Weight and may end up half an ulp below that bound,
+// min_weight is lowered by a few ulps of Weight to stay admissible, this matters for float.
+class euclidean_heuristic : public boost::astar_heuristic<Graph, double>
+{
+public:
+	euclidean_heuristic(const Graph& graph, GraphNode_descriptor target, double min_weight)
+		: graph(graph), target_point(graph_nodes(graph).point(target)),
+		  min_weight(min_weight * (1.0 - 4.0 * std::numeric_limits<Weight>::epsilon()))
+	{
+	}
+
+	double operator()(GraphNode_descriptor u) const
+	{
+		return min_weight * norm(graph_nodes(graph).point(u), target_point);
+	}
+
+private:
+	const Graph& graph;
+	Point target_point;
+	double min_weight;
+};
+
+// full single source shortest path tree rooted at s, results are left in workspace
+void dijkstra(const Graph& graph, GraphNode_descriptor s, DijkstraWorkspace& workspace);
+
+// shortest path from s to t, the search stops as soon as t is settled.
+// afterwards, distance[t] and the predecessor chain from t back to s are final,
+// all other nodes may carry tentative values or infinity.
+void dijkstra_to(const Graph& graph, GraphNode_descriptor s, GraphNode_descriptor t, DijkstraWorkspace& workspace);
+
+// shortest path from s to t by two searches from s and t that meet in the middle,
+// the graph must be undirected. the path is written to the forward buffers
+// such that the results can be used exactly like those of dijkstra_to.
+void bidirectional_dijkstra(const Graph& graph, GraphNode_descriptor s, GraphNode_descriptor t, DijkstraWorkspace& workspace);
+
+// shortest path from s to t by A* with euclidean_heuristic, using workspace.min_weight.
+// the results can be used exactly like those of dijkstra_to.
+void astar(const Graph& graph, GraphNode_descriptor s, GraphNode_descriptor t, DijkstraWorkspace& workspace);
+
+// s-t query with the given algorithm
+void shortest_path_query(const Graph& graph, GraphNode_descriptor s, GraphNode_descriptor t, QueryAlgorithm algorithm, DijkstraWorkspace& workspace);
+
+// one search from all sources at once (each at distance 0), stops as soon as all targets are settled.
+// afterwards, distance[t] is the distance from the nearest source and the predecessor chain of t ends there,
+// for each target t. an empty target list runs the full search like dijkstra.
+void dijkstra_to_many(const Graph& graph, const std::vector<GraphNode_descriptor>& sources, const std::vector<GraphNode_descriptor>& targets, DijkstraWorkspace& workspace);
+
+#endif
@@ -0,0 +1,376 @@
+#include "graph_cache.h"
+
+#ifndef __EMSCRIPTEN__
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <sstream>
+
+static const char graph_cache_magic[8] = "wspgrph";
+static const uint32_t graph_cache_byte_order = 0x01020304;
+
+// word by word hash, good enough to tell meshes and parameters apart
+class Hash
+{
+public:
+	Hash() : h(0xCBF29CE484222325ull) {}
+
+	void add(uint64_t word)
+	{
+		h = (h ^ word) * 0x9E3779B97F4A7C15ull;
+		h ^= h >> 29;
+	}
+
+	void add(double value)
+	{
+		uint64_t word;
+		std::memcpy(&word, &value, sizeof(word));
+		add(word);
+	}
+
+	void add(int value) { add(static_cast<uint64_t>(static_cast<uint32_t>(value))); }
+
+	uint64_t value() const { return h; }
+
+private:
+	uint64_t h;
+};
+
+uint64_t mesh_hash(const Mesh& mesh)
+{
+	Hash hash;
+
+	hash.add(static_cast<uint64_t>(mesh.n_vertices()));
+	for (auto it = mesh.vertices_begin(); it != mesh.vertices_end(); ++it)
+	{
+		Point p = mesh.vertex(*it);
+		hash.add(p[0]);
+		hash.add(p[1]);
+		hash.add(p[2]);
+	}
+
+	hash.add(static_cast<uint64_t>(mesh.n_edges()));
+	for (auto it = mesh.edges_begin(); it != mesh.edges_end(); ++it)
+	{
+		Edge e = mesh.edge(*it);
+		hash.add(e.from_vertex().idx());
+		hash.add(e.to_vertex().idx());
+	}
+
+	hash.add(static_cast<uint64_t>(mesh.n_faces()));
+	for (auto it = mesh.faces_begin(); it != mesh.faces_end(); ++it)
+	{
+		for (auto heh : mesh.face(*it).halfedges())
+			hash.add(heh.idx());
+	}
+
+	hash.add(static_cast<uint64_t>(mesh.n_cells()));
+	for (auto it = mesh.cells_begin(); it != mesh.cells_end(); ++it)
+	{
+		for (auto hfh : mesh.cell(*it).halffaces())
+			hash.add(hfh.idx());
+	}
+
+	for (double weight : mesh._cellWeight)
+		hash.add(weight);
+
+	return hash.value();
+}
+
+std::string graph_cache_filename(const std::string& filename, uint64_t mesh_hash, double stretch, double yardstick)
+{
+	Hash hash;
+	hash.add(mesh_hash);
+	hash.add(stretch);
+	hash.add(yardstick);
+	hash.add(static_cast<uint64_t>(graph_cache_version));
+	hash.add(static_cast<uint64_t>(sizeof(Weight)));
+
+	std::ostringstream name;
+	name << filename << "_" << std::hex << std::setw(16) << std::setfill('0') << hash.value() << ".wspgraph";
+	return name.str();
+}
+
+static uint64_t graph_cache_size(const GraphCacheHeader& header)
+{
+	return sizeof(GraphCacheHeader)
+		+ sizeof(uint64_t) * ((header.n_nodes + 1) + (header.n_mesh_edges + 1) + (header.n_mesh_faces + 1))
+		+ sizeof(Weight) * header.n_edges
+		+ sizeof(Coordinate) * 3 * header.n_nodes
+		+ sizeof(uint32_t) * (header.n_edges + header.n_nodes + header.n_mesh_vertices + header.n_edge_nodes + header.n_face_nodes);
+}
+
+// the nodes of each mesh feature, stored as start offsets and a flat node array
+static void read_feature_nodes(std::vector<std::vector<GraphNode_descriptor>>& feature_nodes, uint64_t n, const uint64_t* start, const uint32_t* nodes)
+{
+	feature_nodes.assign(n, std::vector<GraphNode_descriptor>());
+	for (uint64_t i = 0; i < n; ++i)
+		feature_nodes[i].assign(nodes + start[i], nodes + start[i + 1]);
+}
+
+// offsets of a row table: starting at 0, non decreasing and ending at n
+static bool valid_start(const uint64_t* start, uint64_t n_rows, uint64_t n)
+{
+	if (start[0] != 0 || start[n_rows] != n)
+		return false;
+	for (uint64_t i = 0; i < n_rows; ++i)
+		if (start[i] > start[i + 1])
+			return false;
+	return true;
+}
+
+static bool valid_nodes(const uint32_t* nodes, uint64_t n, uint64_t n_nodes)
+{
+	for (uint64_t i = 0; i < n; ++i)
+		if (nodes[i] >= n_nodes)
+			return false;
+	return true;
+}
+
+static void write_feature_nodes(const std::vector<std::vector<GraphNode_descriptor>>& feature_nodes, std::vector<uint64_t>& start, std::vector<uint32_t>& nodes)
+{
+	start.assign(1, 0);
+	for (const auto& f : feature_nodes)
+	{
+		nodes.insert(nodes.end(), f.begin(), f.end());
+		start.push_back(nodes.size());
+	}
+}
+
+bool read_graph_cache(Graph& graph, Mesh& mesh, const std::string& filename, uint64_t hash, double stretch, double yardstick)
+{
+	std::string cache_filename = graph_cache_filename(filename, hash, stretch, yardstick);
+
+	if (!boost::filesystem::exists(cache_filename))
+		return false;
+
+	try
+	{
+		boost::interprocess::file_mapping file(cache_filename.c_str(), boost::interprocess::read_only);
+		boost::interprocess::mapped_region region(file, boost::interprocess::read_only);
+
+		const char* data = static_cast<const char*>(region.get_address());
+		size_t size = region.get_size();
+
+		if (size < sizeof(GraphCacheHeader))
+			return false;
+
+		GraphCacheHeader header;
+		std::memcpy(&header, data, sizeof(GraphCacheHeader));
+
+		// each count is bounded by the file size first, so the size sum of a corrupt header cannot wrap around
+		if (std::memcmp(header.magic, graph_cache_magic, sizeof(header.magic)) != 0 ||
+			header.version != graph_cache_version ||
+			header.byte_order != graph_cache_byte_order ||
+			header.weight_size != sizeof(Weight) ||
+			header.n_nodes > size || header.n_edges > size ||
+			header.n_mesh_vertices > size || header.n_mesh_edges > size || header.n_mesh_faces > size ||
+			header.n_edge_nodes > size || header.n_face_nodes > size ||
+			graph_cache_size(header) != size)
+		{
+			std::cout << "read_graph_cache: ignoring incompatible cache " << cache_filename << std::endl;
+			return false;
+		}
+
+		// the file name is a hash, so the full key is checked again
+		if (header.mesh_hash != hash ||
+			header.stretch != stretch ||
+			header.yardstick != yardstick ||
+			header.n_mesh_vertices != mesh.n_vertices() ||
+			header.n_mesh_edges != mesh.n_edges() ||
+			header.n_mesh_faces != mesh.n_faces())
+		{
+			std::cout << "read_graph_cache: ignoring cache " << cache_filename << " of another mesh" << std::endl;
+			return false;
+		}
+
+		const uint64_t* row_start = reinterpret_cast<const uint64_t*>(data + sizeof(GraphCacheHeader));
+		const uint64_t* edge_node_start = row_start + header.n_nodes + 1;
+		const uint64_t* face_node_start = edge_node_start + header.n_mesh_edges + 1;
+		const Weight* weights = reinterpret_cast<const Weight*>(face_node_start + header.n_mesh_faces + 1);
+		const Coordinate* x = reinterpret_cast<const Coordinate*>(weights + header.n_edges);
+		const Coordinate* y = x + header.n_nodes;
+		const Coordinate* z = y + header.n_nodes;
+		const uint32_t* targets = reinterpret_cast<const uint32_t*>(z + header.n_nodes);
+		const uint32_t* origin = targets + header.n_edges;
+		const uint32_t* vertex_nodes = origin + header.n_nodes;
+		const uint32_t* edge_nodes = vertex_nodes + header.n_mesh_vertices;
+		const uint32_t* face_nodes = edge_nodes + header.n_edge_nodes;
+
+		// a damaged file must not lead to out of range nodes in the graph or the mesh features
+		bool valid = header.n_nodes <= std::numeric_limits<GraphNode_descriptor>::max() &&
+			valid_start(row_start, header.n_nodes, header.n_edges) &&
+			valid_start(edge_node_start, header.n_mesh_edges, header.n_edge_nodes) &&
+			valid_start(face_node_start, header.n_mesh_faces, header.n_face_nodes) &&
+			valid_nodes(targets, header.n_edges, header.n_nodes) &&
+			valid_nodes(vertex_nodes, header.n_mesh_vertices, header.n_nodes) &&
+			valid_nodes(edge_nodes, header.n_edge_nodes, header.n_nodes) &&
+			valid_nodes(face_nodes, header.n_face_nodes, header.n_nodes);
+
+		for (uint64_t i = 0; valid && i < header.n_edges; ++i)
+			valid = weights[i] >= 0; // false for nan too
+
+		// the feature index must exist for its kind, nodes without a feature have index 0
+		const uint64_t n_features[] = { 1, header.n_mesh_vertices, header.n_mesh_edges, header.n_mesh_faces };
+		for (uint64_t u = 0; valid && u < header.n_nodes; ++u)
+			valid = (origin[u] & GraphNodes::index_mask) < n_features[origin[u] >> GraphNodes::kind_shift];
+
+		if (!valid)
+		{
+			std::cout << "read_graph_cache: ignoring corrupt cache " << cache_filename << std::endl;
+			return false;
+		}
+
+		std::cout << "read_graph_cache: reading " << cache_filename << " ..." << std::endl;
+
+		// the rows are stored in order, so the edges are sorted by source as freeze_graph has them and the
+		// in place construction takes targets and edge_properties over without sorting or copying them again
+		{
+			std::vector<GraphNode_descriptor> sources(header.n_edges);
+			for (uint64_t u = 0; u < header.n_nodes; ++u)
+				std::fill(sources.begin() + row_start[u], sources.begin() + row_start[u + 1], static_cast<GraphNode_descriptor>(u));
+
+			std::vector<GraphNode_descriptor> graph_targets(targets, targets + header.n_edges);
+
+			// GraphEdge holds nothing but the weight
+			std::vector<GraphEdge> edge_properties(header.n_edges);
+			for (uint64_t i = 0; i < header.n_edges; ++i)
+				edge_properties[i].weight = weights[i];
+
+			graph = Graph(boost::construct_inplace_from_sources_and_targets, sources, graph_targets, edge_properties, header.n_nodes);
+		}
+
+		GraphNodes& nodes = graph_nodes(graph);
+		nodes.x.assign(x, x + header.n_nodes);
+		nodes.y.assign(y, y + header.n_nodes);
+		nodes.z.assign(z, z + header.n_nodes);
+		nodes.origin.assign(origin, origin + header.n_nodes);
+
+		mesh._vertexNode.assign(vertex_nodes, vertex_nodes + header.n_mesh_vertices);
+		read_feature_nodes(mesh._edgeNodes, header.n_mesh_edges, edge_node_start, edge_nodes);
+		read_feature_nodes(mesh._faceNodes, header.n_mesh_faces, face_node_start, face_nodes);
+	}
+	catch (const boost::interprocess::interprocess_exception& e)
+	{
+		std::cerr << "read_graph_cache: failed to map " << cache_filename << ": " << e.what() << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+bool write_graph_cache(const Graph& graph, const Mesh& mesh, const std::string& filename, uint64_t hash, double stretch, double yardstick)
+{
+	GraphCacheHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, graph_cache_magic, sizeof(header.magic));
+	header.version = graph_cache_version;
+	header.byte_order = graph_cache_byte_order;
+	header.weight_size = sizeof(Weight);
+	header.mesh_hash = hash;
+	header.stretch = stretch;
+	header.yardstick = yardstick;
+	header.n_nodes = num_vertices(graph);
+	header.n_edges = num_edges(graph);
+	header.n_mesh_vertices = mesh.n_vertices();
+	header.n_mesh_edges = mesh.n_edges();
+	header.n_mesh_faces = mesh.n_faces();
+
+	// the queries need the graph nodes of all mesh features
+	if (mesh._vertexNode.size() != header.n_mesh_vertices ||
+		mesh._edgeNodes.size() != header.n_mesh_edges ||
+		mesh._faceNodes.size() != header.n_mesh_faces)
+	{
+		std::cerr << "write_graph_cache: mesh features without graph nodes, not cached" << std::endl;
+		return false;
+	}
+
+	std::string cache_filename = graph_cache_filename(filename, header.mesh_hash, stretch, yardstick);
+
+	std::vector<uint64_t> row_start;
+	row_start.reserve(header.n_nodes + 1);
+
+	std::vector<Weight> weights;
+	std::vector<uint32_t> targets;
+	weights.reserve(header.n_edges);
+	targets.reserve(header.n_edges);
+
+	const GraphNodes& nodes = graph_nodes(graph);
+
+	row_start.push_back(0);
+	for (GraphNode_descriptor u = 0; u < header.n_nodes; ++u)
+	{
+		Graph::out_edge_iterator edgeIt, edgeEnd;
+		for (boost::tie(edgeIt, edgeEnd) = boost::out_edges(u, graph); edgeIt != edgeEnd; ++edgeIt)
+		{
+			targets.push_back(boost::target(*edgeIt, graph));
+			weights.push_back(graph[*edgeIt].weight);
+		}
+		row_start.push_back(targets.size());
+	}
+
+	std::vector<uint64_t> edge_node_start;
+	std::vector<uint32_t> edge_nodes;
+	write_feature_nodes(mesh._edgeNodes, edge_node_start, edge_nodes);
+	header.n_edge_nodes = edge_nodes.size();
+
+	std::vector<uint64_t> face_node_start;
+	std::vector<uint32_t> face_nodes;
+	write_feature_nodes(mesh._faceNodes, face_node_start, face_nodes);
+	header.n_face_nodes = face_nodes.size();
+
+	// concurrent runs on the same mesh must not see a partial file, nor write to the same temporary file.
+	// the last rename wins, the files are equal anyway
+	std::string temp_filename = cache_filename + "." + boost::filesystem::unique_path().string() + ".tmp";
+	{
+		std::ofstream output(temp_filename, std::ios::binary);
+		if (!output.is_open())
+		{
+			std::cerr << "write_graph_cache: failed to open " << temp_filename << std::endl;
+			return false;
+		}
+
+		output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		output.write(reinterpret_cast<const char*>(row_start.data()), sizeof(uint64_t) * row_start.size());
+		output.write(reinterpret_cast<const char*>(edge_node_start.data()), sizeof(uint64_t) * edge_node_start.size());
+		output.write(reinterpret_cast<const char*>(face_node_start.data()), sizeof(uint64_t) * face_node_start.size());
+		output.write(reinterpret_cast<const char*>(weights.data()), sizeof(Weight) * weights.size());
+		output.write(reinterpret_cast<const char*>(nodes.x.data()), sizeof(Coordinate) * nodes.x.size());
+		output.write(reinterpret_cast<const char*>(nodes.y.data()), sizeof(Coordinate) * nodes.y.size());
+		output.write(reinterpret_cast<const char*>(nodes.z.data()), sizeof(Coordinate) * nodes.z.size());
+		output.write(reinterpret_cast<const char*>(targets.data()), sizeof(uint32_t) * targets.size());
+		output.write(reinterpret_cast<const char*>(nodes.origin.data()), sizeof(uint32_t) * nodes.origin.size());
+		output.write(reinterpret_cast<const char*>(mesh._vertexNode.data()), sizeof(uint32_t) * mesh._vertexNode.size());
+		output.write(reinterpret_cast<const char*>(edge_nodes.data()), sizeof(uint32_t) * edge_nodes.size());
+		output.write(reinterpret_cast<const char*>(face_nodes.data()), sizeof(uint32_t) * face_nodes.size());
+
+		if (!output)
+		{
+			std::cerr << "write_graph_cache: failed to write " << temp_filename << std::endl;
+			output.close();
+			boost::system::error_code ignored;
+			boost::filesystem::remove(temp_filename, ignored);
+			return false;
+		}
+	}
+
+	boost::system::error_code error;
+	boost::filesystem::rename(temp_filename, cache_filename, error);
+	if (error)
+	{
+		std::cerr << "write_graph_cache: failed to rename " << temp_filename << ": " << error.message() << std::endl;
+		boost::system::error_code ignored;
+		boost::filesystem::remove(temp_filename, ignored);
+		return false;
+	}
+
+	std::cout << "write_graph_cache: wrote " << cache_filename << std::endl;
+	return true;
+}
+
+#endif
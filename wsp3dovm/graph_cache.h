@@ -0,0 +1,61 @@
+#ifndef GRAPH_CACHE_H
+#define GRAPH_CACHE_H
+
+#include "common.h"
+
+// binary cache of a finished steiner graph together with the graph nodes of the mesh features.
+// the cache is named after a hash of the mesh (geometry, topology and cell weights) and the
+// construction parameters, so each parameter set of a sweep gets its own file.
+//
+// layout: GraphCacheHeader, then the arrays in the layout of the graph in memory, 8 byte aligned
+//   uint64_t   row_start[n_nodes + 1]		csr row start of each node
+//   uint64_t   edge_node_start[n_mesh_edges + 1]
+//   uint64_t   face_node_start[n_mesh_faces + 1]
+//   Weight     weights[n_edges]			csr edge weights, each undirected edge in both directions
+//   Coordinate x[n_nodes], y[n_nodes], z[n_nodes]
+//   uint32_t   targets[n_edges]			csr edge targets
+//   uint32_t   origin[n_nodes]				GraphNodes::origin, kind and index of the mesh feature
+//   uint32_t   vertex_nodes[n_mesh_vertices]
+//   uint32_t   edge_nodes[n_edge_nodes]
+//   uint32_t   face_nodes[n_face_nodes]
+// Weight and Coordinate are float or double as the build has them, 8 byte arrays come first so all stay aligned.
+
+const uint32_t graph_cache_version = 3;
+
+struct GraphCacheHeader
+{
+	char magic[8];				// "wspgrph"
+	uint32_t version;			// graph_cache_version
+	uint32_t byte_order;		// 0x01020304 as written by the producing machine
+	uint32_t weight_size;		// sizeof(Weight) and sizeof(Coordinate) of the producing build
+	uint32_t reserved;
+
+	uint64_t mesh_hash;			// mesh_hash of the mesh the graph was built for
+	double stretch;
+	double yardstick;
+
+	uint64_t n_nodes;
+	uint64_t n_edges;
+
+	uint64_t n_mesh_vertices;
+	uint64_t n_mesh_edges;
+	uint64_t n_mesh_faces;
+	uint64_t n_edge_nodes;
+	uint64_t n_face_nodes;
+};
+
+// hash of the mesh geometry, topology and cell weights
+uint64_t mesh_hash(const Mesh& mesh);
+
+// cache file name for the graph of a mesh read from filename (without extension),
+// float and double builds use different files
+std::string graph_cache_filename(const std::string& filename, uint64_t mesh_hash, double stretch, double yardstick);
+
+// reads the graph and the graph nodes of the mesh features from the cache, hash is mesh_hash(mesh).
+// returns false if there is no matching cache or it is unreadable or corrupt, graph and mesh are untouched then.
+bool read_graph_cache(Graph& graph, Mesh& mesh, const std::string& filename, uint64_t hash, double stretch, double yardstick);
+
+// writes the cache for a graph built for mesh, hash is mesh_hash(mesh). returns false on failure
+bool write_graph_cache(const Graph& graph, const Mesh& mesh, const std::string& filename, uint64_t hash, double stretch, double yardstick);
+
+#endif
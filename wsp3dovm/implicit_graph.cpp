@@ -0,0 +1,36 @@
+#include "implicit_graph.h"
+
+// counting sort of the (feature, cell) incidences into csr arrays
+static void cell_incidences(const std::vector<int>& cell_features, int features_per_cell, size_t n_features, std::vector<size_t>& start, std::vector<int>& cells)
+{
+	start.assign(n_features + 1, 0);
+	for (int feature : cell_features)
+		++start[feature + 1];
+	for (size_t i = 0; i < n_features; ++i)
+		start[i + 1] += start[i];
+
+	cells.resize(cell_features.size());
+	std::vector<size_t> next(start.begin(), start.end() - 1);
+	for (size_t i = 0; i < cell_features.size(); ++i)
+		cells[next[cell_features[i]]++] = static_cast<int>(i / features_per_cell);
+}
+
+ImplicitGraph::ImplicitGraph(const Graph& graph, const Mesh& mesh, int num_threads)
+	: graph(graph), mesh(mesh), cell(mesh, num_threads)
+{
+	face_cells.assign(2 * mesh.n_faces(), -1);
+	for (size_t i = 0; i < cell.faces.size(); ++i)
+	{
+		int* cells = &face_cells[2 * cell.faces[i]];
+		cells[cells[0] < 0 ? 0 : 1] = static_cast<int>(i / 4);
+	}
+
+	cell_incidences(cell.vertices, 4, mesh.n_vertices(), vertex_cell_start, vertex_cells);
+	cell_incidences(cell.edges, 6, mesh.n_edges(), edge_cell_start, edge_cells);
+}
+
+size_t ImplicitGraph::memory() const
+{
+	return cell.memory() + sizeof(int) * (vertex_cells.size() + edge_cells.size() + face_cells.size())
+		+ sizeof(size_t) * (vertex_cell_start.size() + edge_cell_start.size());
+}
@@ -0,0 +1,97 @@
+#ifndef IMPLICIT_GRAPH_H
+#define IMPLICIT_GRAPH_H
+
+#include "common.h"
+#include "cell_features.h"
+
+// the complete steiner graph (stretch 0) without materialized edges.
+// graph holds the nodes only, the neighbours of a node are the nodes of all cells incident to
+// its mesh vertex, edge or face and are generated from the mesh whenever a search relaxes the node.
+// as in create_steiner_graph_improved_spanner, edge (u,v) weighs |uv| times the minimal weight of the
+// cells containing both: v is reported once per common cell and the search keeps the cheapest.
+// memory is O(nodes + cells) instead of O(cells * nodes per cell^2) for the edges.
+class ImplicitGraph
+{
+public:
+	// the mesh must be tetrahedral, graph and mesh must outlive the implicit graph.
+	// the incidences are built on num_threads threads (0: all hardware threads).
+	ImplicitGraph(const Graph& graph, const Mesh& mesh, int num_threads = 1);
+
+	// calls f(v, weight) for each neighbour v of u, possibly several times with different weights
+	template <class Function>
+	void for_each_neighbor(GraphNode_descriptor u, Function f) const
+	{
+		const GraphNodes& nodes = graph_nodes(graph);
+		Point p = nodes.point(u);
+		int index = nodes.index(u);
+
+		const int* cells;
+		const int* cells_end;
+		if (nodes.kind(u) == GraphNodes::VERTEX)
+		{
+			cells = vertex_cells.data() + vertex_cell_start[index];
+			cells_end = vertex_cells.data() + vertex_cell_start[index + 1];
+		}
+		else if (nodes.kind(u) == GraphNodes::EDGE)
+		{
+			cells = edge_cells.data() + edge_cell_start[index];
+			cells_end = edge_cells.data() + edge_cell_start[index + 1];
+		}
+		else
+		{
+			cells = face_cells.data() + 2 * index;
+			cells_end = cells + 2;
+		}
+
+		for (; cells != cells_end; ++cells)
+		{
+			int c = *cells;
+			if (c < 0)
+				continue; // boundary face
+
+			double weight = mesh.weight(CellHandle(c));
+
+			for (int i = 0; i < 4; ++i)
+				visit(u, p, weight, mesh.v_node(VertexHandle(cell.vertices[4 * c + i])), f);
+
+			for (int i = 0; i < 6; ++i)
+			{
+				for (GraphNode_descriptor v : mesh.e_nodes(EdgeHandle(cell.edges[6 * c + i])))
+					visit(u, p, weight, v, f);
+			}
+
+			for (int i = 0; i < 4; ++i)
+			{
+				for (GraphNode_descriptor v : mesh.f_nodes(FaceHandle(cell.faces[4 * c + i])))
+					visit(u, p, weight, v, f);
+			}
+		}
+	}
+
+	// bytes allocated for the incidences
+	size_t memory() const;
+
+private:
+	// rounded to the precision of the graph edges, as they would be stored
+	template <class Function>
+	void visit(GraphNode_descriptor u, const Point& p, double weight, GraphNode_descriptor v, Function& f) const
+	{
+		if (v != u)
+			f(v, static_cast<Weight>(weight * norm(p, graph_nodes(graph).point(v))));
+	}
+
+	const Graph& graph;
+	const Mesh& mesh;
+
+	// mesh features of each cell
+	CellFeatures cell;
+
+	// cells incident to each mesh feature, in csr format for vertices and edges
+	std::vector<size_t> vertex_cell_start;
+	std::vector<int> vertex_cells;
+	std::vector<size_t> edge_cell_start;
+	std::vector<int> edge_cells;
+	std::vector<int> face_cells;	// 2 per face, -1 on the boundary
+};
+
+#endif
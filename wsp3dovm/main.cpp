@@ -1,11 +1,25 @@
 #include "common.h"
 
+#include "cell_features.h"
 #include "create_steinerpoints.h"
+#include "delta_stepping.h"
+#include "dijkstra.h"
+#include "graph_cache.h"
+#include "implicit_graph.h"
+#include "parallel.h"
+#include "query_server.h"
 #include "read_tet.h"
 #include "statistics.h"
 #include "write_tet.h"
 #include "write_vtk.h"
 
+#include <boost/endian/conversion.hpp>
+
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <mutex>
+
 using namespace std;
 using namespace boost;
 using namespace boost::chrono;
@@ -24,101 +38,38 @@ public:
     }
 };
 
-void set_random_cell_weights(Mesh& mesh) {
-    // random_device may be a non-deterministic random number generator using hardware entropy source
-    //std::random_device random_device;
-    std::mt19937 generator /*(random_device())*/;
-    std::uniform_real_distribution<> random_value(1, 1000);
-
-    // is not clear to me, what a good distribution could look like.
-    // the lower limit 1 is such that it is not too close to 0 (where all paths would have equal length 0)
-    // but allows for a higher max/min ratio such that path reflection on faces/edges is quite possible
-    mesh._cellWeight.resize(mesh.n_cells());
-
-    for (auto c_it = mesh.cells_begin(); c_it != mesh.cells_end(); ++c_it) {
-        CellHandle ch = *c_it;
-        mesh.weight(ch) = random_value(generator);
-    }
-}
-
-void calc_face_weights(Mesh& mesh) {
-    mesh._faceWeight.resize(mesh.n_faces());
-
-    for (auto f_it = mesh.faces_begin(); f_it != mesh.faces_end(); ++f_it) {
-        OpenVolumeMesh::FaceHandle fh = *f_it;
-
-        OpenVolumeMesh::HalfFaceHandle hfh0 = Kernel::halfface_handle(fh, 0);
-        OpenVolumeMesh::HalfFaceHandle hfh1 = Kernel::halfface_handle(fh, 1);
-
-        CellHandle cell0 = mesh.incident_cell(hfh0);
-        CellHandle cell1 = mesh.incident_cell(hfh1);
-
-        double w0 = cell0.is_valid() ? mesh.weight(cell0) : max_weight;
-        double w1 = cell1.is_valid() ? mesh.weight(cell1) : max_weight;
-
-        mesh.weight(fh) = std::min(w0, w1);
-    }
-}
-
-void calc_edge_weights(Mesh& mesh) {
-    mesh._edgeWeight.resize(mesh.n_edges());
-
-    for (auto e_it = mesh.edges_begin(); e_it != mesh.edges_end(); ++e_it) {
-        OpenVolumeMesh::EdgeHandle eh = *e_it;
-
-        //std::cout << "processing edge " << e_it->idx() << " " << mesh.edge(*e_it) << "of valence " << mesh.valence(*e_it) << std::endl;
-
-        OpenVolumeMesh::HalfEdgeHandle heh0 = Kernel::halfedge_handle(eh, 0);
-        //OpenVolumeMesh::HalfEdgeHandle heh1 = Kernel::halfedge_handle(eh, 1);
-
-        Weight weight = max_weight;
-
-        for (auto hec0 = mesh.hec_iter(heh0); hec0; ++hec0) {
-            //std::cout << "  hec0 incident cell " << hec0->idx() << std::endl;
-            if (hec0->is_valid())
-                weight = std::min(weight, mesh.weight(*hec0));
-        }
-
-        // this yields exactly the same cells in reverse order
-
-        //for (auto hec1 = mesh.hec_iter(heh1); hec1; ++hec1)
-        //{
-        //	std::cout << "  hec1 incident cell " << hec1->idx() << std::endl;
-        //if (hec1->is_valid())
-        //		weight = std::min(weight, mesh.weight(*hec1));
-        //}
-
-        mesh.weight(eh) = weight;
-    }
-}
-
 std::ofstream distance_stream;
 
+// the vtk writers report to std::cout, so dumps of concurrent queries are serialized
+std::mutex dump_mutex;
+
+// the distances are temporary, so they are kept in the (per thread) workspace
 double run_single_dijkstra(
     const Graph& graph,
     const Mesh& mesh,
     int s_node,
     int t_node,
+    DijkstraWorkspace& workspace,
+    QueryAlgorithm algorithm = QUERY_DIJKSTRA,
     bool dump_path = false,
     bool dump_cells = false,
     bool dump_tree = false,
-    filesystem::path basename = "out") {
-    // the distances are temporary, so we choose an external property for that
-    std::vector<double> distance(num_vertices(graph));
-    std::vector<GraphNode_descriptor> predecessor(num_vertices(graph));
-
-    boost::dijkstra_shortest_paths(
-        graph,
-        s_node,
-        boost::weight_map(get(&GraphEdge::weight, graph)).distance_map(boost::make_iterator_property_map(distance.begin(), get(boost::vertex_index, graph))).predecessor_map(boost::make_iterator_property_map(predecessor.begin(), get(boost::vertex_index, graph))).distance_inf(std::numeric_limits<double>::infinity()));
-
-    double euclidean_distance = norm(graph[s_node].point, graph[t_node].point);
-    double approx_distance = distance[t_node];
-    double approx_ratio = approx_distance / euclidean_distance;
-
-    distance_stream << approx_distance << ", ";
-
+    boost::filesystem::path basename = "out",
+    VtkFormat vtk_format = VTK_ASCII,
+    int tree_threads = 1,
+    double delta = 0) {
+    const std::vector<double>& distance = workspace.distance;
+    const std::vector<GraphNode_descriptor>& predecessor = workspace.predecessor;
+
+    // the full tree is only needed for the tree dump, otherwise we stop as soon as t_node is settled
     if (dump_tree) {
+        // large trees are computed by delta-stepping on several threads
+        if (worker_threads(tree_threads) > 1)
+            delta_stepping(graph, s_node, delta, tree_threads, workspace);
+        else
+            dijkstra(graph, s_node, workspace);
+
+        std::lock_guard<std::mutex> lock(dump_mutex);
         timer<high_resolution_clock> t;
 
         stringstream extension;
@@ -129,11 +80,22 @@ double run_single_dijkstra(
             s_node,
             predecessor,
             distance,
-            basename.filename().replace_extension(extension.str()).string());
+            basename.filename().replace_extension(extension.str()).string(),
+            vtk_format);
 
         std::cout << "write_shortest_path_tree_vtk: " << t.seconds() << " s" << std::endl;
     }
 
+    // the query runs even after a tree dump, so the settled nodes are those of a search stopping at t_node
+    // for all algorithms, not the whole tree
+    shortest_path_query(graph, s_node, t_node, algorithm, workspace);
+
+    double euclidean_distance = norm(graph_nodes(graph).point(s_node), graph_nodes(graph).point(t_node));
+    double approx_distance = distance[t_node];
+    double approx_ratio = approx_distance / euclidean_distance;
+
+    std::lock_guard<std::mutex> lock(dump_mutex);
+
     if (dump_path) {
         timer<high_resolution_clock> t;
 
@@ -146,7 +108,8 @@ double run_single_dijkstra(
             t_node,
             predecessor,
             distance,
-            basename.filename().replace_extension(extension.str()).string());
+            basename.filename().replace_extension(extension.str()).string(),
+            vtk_format);
         std::cout << "write_shortest_path_to_vtk: " << t.seconds() << " s" << std::endl;
     }
 
@@ -163,7 +126,8 @@ double run_single_dijkstra(
             t_node,
             predecessor,
             distance,
-            basename.filename().replace_extension(extension.str()).string());
+            basename.filename().replace_extension(extension.str()).string(),
+            vtk_format);
         std::cout << "write_shortest_path_cells_from_to_vtk: " << t.seconds() << " s" << std::endl;
 
         std::set<CellHandle> cells = cells_from_graph_nodes(graph, mesh, s_node, t_node, predecessor);
@@ -175,6 +139,73 @@ double run_single_dijkstra(
 }
 
 #ifndef __EMSCRIPTEN__
+// reads mesh vertex numbers separated by commas or whitespace, "@filename" reads them from a file.
+// returns false for unreadable input and numbers that are no mesh vertex.
+bool parse_vertex_list(const std::string& list, const Mesh& mesh, std::vector<int>& vertices) {
+    std::string text = list;
+
+    if (!list.empty() && list[0] == '@') {
+        std::ifstream file(list.substr(1));
+        if (!file)
+            return false;
+        text.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+
+    std::replace(text.begin(), text.end(), ',', ' ');
+    std::istringstream input(text);
+
+    int vertex;
+    while (input >> vertex) {
+        if (vertex < 0 || vertex >= static_cast<int>(mesh.n_vertices()))
+            return false;
+        vertices.push_back(vertex);
+    }
+
+    return input.eof();
+}
+
+// csv: one "vertex, distance" line per target, unreachable targets have distance inf.
+// binary: the number of targets as little endian uint64, followed by their distances as little endian doubles.
+void write_one_to_many_distances(
+    const Mesh& mesh,
+    const std::vector<int>& targets,
+    const std::vector<double>& distance,
+    bool binary,
+    const std::string& filename) {
+    std::ofstream output(filename, binary ? std::ios::binary : std::ios::out);
+    if (!output) {
+        std::cerr << "cannot write " << filename << std::endl;
+        return;
+    }
+
+    if (binary) {
+        uint64_t n = boost::endian::native_to_little(static_cast<uint64_t>(targets.size()));
+        output.write(reinterpret_cast<const char*>(&n), sizeof(n));
+
+        for (int vertex : targets) {
+            double d = distance[mesh.v_node(VertexHandle(vertex))];
+            uint64_t bits;
+            std::memcpy(&bits, &d, sizeof(bits));
+            boost::endian::native_to_little_inplace(bits);
+            output.write(reinterpret_cast<const char*>(&bits), sizeof(bits));
+        }
+    } else {
+        // distances are printed such that they read back exactly
+        output.precision(std::numeric_limits<double>::max_digits10);
+        output << "vertex, distance\n";
+
+        for (int vertex : targets) {
+            double d = distance[mesh.v_node(VertexHandle(vertex))];
+            output << vertex << ", ";
+            if (std::isfinite(d))
+                output << d;
+            else
+                output << "inf";
+            output << "\n";
+        }
+    }
+}
+
 int main(int argc, char** argv) {
     timer<high_resolution_clock> total_time;
 
@@ -188,14 +219,27 @@ int main(int argc, char** argv) {
         bool write_mesh_vtk;
         bool write_steiner_graph_vtk;
         bool use_random_cellweights;
+        bool use_mesh_cache;         // read the mesh from the binary cache
+        bool use_graph_cache;        // read the steiner graph from the binary cache
+        bool use_implicit_graph;     // generate the graph edges during the queries instead of storing them
+        bool run_server;             // answer queries from stdin after building the graph
+        bool quiet;                  // skip the mesh and steiner point statistics
 
         int num_random_s_t_vertices; // number of randomly generated s and t vertex pairs
+        std::string sources_list;    // one-to-many query: start vertices, all at distance 0
+        std::string targets_list;    // one-to-many query: target vertices, empty for all mesh vertices
+        std::string distance_format_name; // encoding of the one-to-many distances
+        int num_threads;             // worker threads for mesh parsing, weights and statistics, graph construction, the shortest path tree and the random s and t vertex pairs
+        std::string algorithm_name;  // s-t query algorithm
+        std::string queue_name;      // priority queue of the dijkstra searches
+        std::string vtk_format_name; // encoding of all .vtk outputs
 
         double stretch;   // spaner graph stretch factor
         double yardstick; // max. size of edge for edge subdivisions
+        double delta;     // bucket width of the parallel shortest path tree
 
         program_options::options_description desc("Allowed options");
-        desc.add_options()("help,h", "produce help message")("start_vertex,s", program_options::value<int>(&start_vertex)->default_value(-1), "shortest path start vertex number (-1==none/random)")("termination_vertex,t", program_options::value<int>(&termination_vertex)->default_value(-1), "shortest path termination vertex number (-1==none/random)")("random_s_t_vertices,r", program_options::value<int>(&num_random_s_t_vertices)->default_value(0), "number of randomly generated s and t vertex pairs")("spanner_stretch,x", program_options::value<double>(&stretch)->default_value(0.0), "spanner graph stretch factor")("yardstick,y", program_options::value<double>(&yardstick)->default_value(0.0), "interval length for interval scheme (0: do not subdivide edges)")("write_mesh_vtk,m", program_options::value<bool>(&write_mesh_vtk)->default_value(false), "write input mesh as .vtk")("write_steiner_graph_vtk,g", program_options::value<bool>(&write_steiner_graph_vtk)->default_value(false), "write steiner graph as .vtk")("use-random-cellweights,u", program_options::value<bool>(&use_random_cellweights)->default_value(false), "generate (pseudo-)random cell weights internally")("input-mesh", program_options::value<std::string>(), "set input filename (tetgen 3D mesh files wo extension)");
+        desc.add_options()("help,h", "produce help message")("start_vertex,s", program_options::value<int>(&start_vertex)->default_value(-1), "shortest path start vertex number (-1==none/random)")("termination_vertex,t", program_options::value<int>(&termination_vertex)->default_value(-1), "shortest path termination vertex number (-1==none/random)")("random_s_t_vertices,r", program_options::value<int>(&num_random_s_t_vertices)->default_value(0), "number of randomly generated s and t vertex pairs")("threads,j", program_options::value<int>(&num_threads)->default_value(1), "number of worker threads for mesh parsing, weights and statistics, graph construction, the shortest path tree and random s and t vertex pairs (0: all hardware threads)")("algorithm,a", program_options::value<std::string>(&algorithm_name)->default_value("dijkstra"), "s-t query algorithm: dijkstra, bidirectional or astar")("queue,e", program_options::value<std::string>(&queue_name)->default_value("boost"), "priority queue of dijkstra searches: boost, binary or radix")("delta,D", program_options::value<double>(&delta)->default_value(0.0), "bucket width of the delta-stepping shortest path tree, used with more than one thread (0: mean edge weight)")("spanner_stretch,x", program_options::value<double>(&stretch)->default_value(0.0), "spanner graph stretch factor")("yardstick,y", program_options::value<double>(&yardstick)->default_value(0.0), "interval length for interval scheme (0: do not subdivide edges)")("write_mesh_vtk,m", program_options::value<bool>(&write_mesh_vtk)->default_value(false), "write input mesh as .vtk")("write_steiner_graph_vtk,g", program_options::value<bool>(&write_steiner_graph_vtk)->default_value(false), "write steiner graph as .vtk")("vtk_format,f", program_options::value<std::string>(&vtk_format_name)->default_value("ascii"), "encoding of .vtk outputs: ascii or binary")("use-random-cellweights,u", program_options::value<bool>(&use_random_cellweights)->default_value(false), "generate (pseudo-)random cell weights internally")("mesh_cache,c", program_options::value<bool>(&use_mesh_cache)->default_value(false), "read the mesh from a binary cache next to the input mesh, written on first use and checked against the contents of the input mesh")("graph_cache,k", program_options::value<bool>(&use_graph_cache)->default_value(false), "read the steiner graph from a binary cache next to the input mesh, written on first use for each mesh, stretch and yardstick")("implicit_graph,i", program_options::value<bool>(&use_implicit_graph)->default_value(false), "do not store the graph edges but generate them from the mesh during the queries (stretch 0, dijkstra with binary or radix queue only, no steiner graph .vtk or graph cache)")("quiet,Q", program_options::value<bool>(&quiet)->default_value(false), "skip the mesh and steiner point statistics")("server,q", program_options::value<bool>(&run_server)->default_value(false), "answer queries from stdin (st, path, cells, sssp, algorithm, queue, quit) after building the graph")("sources,S", program_options::value<std::string>(&sources_list)->default_value(""), "one-to-many query from these mesh vertices, comma separated or @file (one search seeded with all of them)")("targets,T", program_options::value<std::string>(&targets_list)->default_value(""), "targets of the one-to-many query, comma separated or @file (default: all mesh vertices)")("distance_format,d", program_options::value<std::string>(&distance_format_name)->default_value("csv"), "encoding of one-to-many distances: csv or binary")("input-mesh", program_options::value<std::string>(), "set input filename (tetgen 3D mesh files wo extension)");
 
         program_options::positional_options_description positional_options;
         positional_options.add("input-mesh", 1);
@@ -227,73 +271,197 @@ int main(int argc, char** argv) {
             return EXIT_FAILURE;
         }
 
+        QueryAlgorithm algorithm;
+        if (!parse_query_algorithm(algorithm_name, algorithm)) {
+            cout << "unknown algorithm \"" << algorithm_name << "\", exit." << endl;
+            std::cout << desc << endl;
+            return EXIT_FAILURE;
+        }
+
+        PriorityQueue queue;
+        if (!parse_priority_queue(queue_name, queue)) {
+            cout << "unknown priority queue \"" << queue_name << "\", exit." << endl;
+            std::cout << desc << endl;
+            return EXIT_FAILURE;
+        }
+
+        VtkFormat vtk_format;
+        if (!parse_vtk_format(vtk_format_name, vtk_format)) {
+            cout << "unknown vtk format \"" << vtk_format_name << "\", exit." << endl;
+            std::cout << desc << endl;
+            return EXIT_FAILURE;
+        }
+
+        if (use_implicit_graph && stretch != 0.0) {
+            cout << "the implicit graph needs spanner_stretch 0, exit." << endl;
+            return EXIT_FAILURE;
+        }
+
+        // the searches on the implicit graph are plain dijkstra with a binary or radix heap on one thread
+        if (use_implicit_graph && algorithm != QUERY_DIJKSTRA) {
+            cout << "the implicit graph supports the dijkstra algorithm only, exit." << endl;
+            return EXIT_FAILURE;
+        }
+
+        if (use_implicit_graph && queue == QUEUE_BOOST) {
+            if (!vm["queue"].defaulted()) {
+                cout << "the implicit graph needs the binary or radix queue, exit." << endl;
+                return EXIT_FAILURE;
+            }
+            queue = QUEUE_BINARY;
+        }
+
+        // the implicit graph has its nodes but no stored edges to write or cache
+        if (use_implicit_graph && write_steiner_graph_vtk) {
+            cout << "the implicit graph has no edges to write as steiner graph .vtk, exit." << endl;
+            return EXIT_FAILURE;
+        }
+
+        if (use_implicit_graph && use_graph_cache) {
+            cout << "the implicit graph cannot be read from or written to the graph cache, exit." << endl;
+            return EXIT_FAILURE;
+        }
+
+        if (use_implicit_graph && worker_threads(num_threads) > 1 && start_vertex >= 0 && termination_vertex >= 0)
+            cout << "warning: the shortest path tree of the implicit graph is computed by dijkstra on one thread" << endl;
+
+        if (distance_format_name != "csv" && distance_format_name != "binary") {
+            cout << "unknown distance format \"" << distance_format_name << "\", exit." << endl;
+            std::cout << desc << endl;
+            return EXIT_FAILURE;
+        }
+
         boost::filesystem::path inputfilename(vm["input-mesh"].as<string>());
 
         Mesh mesh;
 
         timer<high_resolution_clock> t;
-        read_tet(mesh, inputfilename.string());
+        read_tet(mesh, inputfilename.string(), use_mesh_cache, num_threads);
         std::cout << "read_tet [s]: " << t.seconds() << std::endl;
 
+        if (mesh.n_cells() == 0) {
+            cout << "mesh has no cells, exit." << endl;
+            return EXIT_FAILURE;
+        }
+
         // cell weight are initialized from tet file, weight 1.0 is used when no specific weights are present
         if (use_random_cellweights) {
             set_random_cell_weights(mesh);
         }
-        calc_face_weights(mesh);
-        calc_edge_weights(mesh);
+        {
+            timer<high_resolution_clock> t;
+            calc_face_and_edge_weights(mesh, num_threads);
+            std::cout << "calc_face_and_edge_weights [s]: " << t.seconds() << std::endl;
+        }
+
+        // lower bound for the weight per length of any graph edge, needed by the A* heuristic
+        double min_weight = *std::min_element(mesh._cellWeight.begin(), mesh._cellWeight.end());
+
+        if (!quiet) {
+            timer<high_resolution_clock> t;
+            mesh.print_memory_statistics();
+            print_mesh_statistics(mesh, num_threads);
+            std::cout << "print_mesh_statistics [s]: " << t.seconds() << std::endl;
+        }
 
-        mesh.print_memory_statistics();
-        print_mesh_statistics(mesh);
+        // checked before the graph is built, which may take a while
+        std::vector<int> source_vertices;
+        std::vector<int> target_vertices;
+        if (!parse_vertex_list(sources_list, mesh, source_vertices) || !parse_vertex_list(targets_list, mesh, target_vertices)) {
+            cout << "invalid vertex list for sources or targets, exit." << endl;
+            return EXIT_FAILURE;
+        }
+        if (!source_vertices.empty() && target_vertices.empty()) {
+            for (int v = 0; v < static_cast<int>(mesh.n_vertices()); ++v)
+                target_vertices.push_back(v);
+        }
 
         if (write_mesh_vtk) {
             timer<high_resolution_clock> t;
-            write_vtk(mesh, inputfilename.filename().replace_extension(".vtk").string());
+            write_vtk(mesh, inputfilename.filename().replace_extension(".vtk").string(), vtk_format);
             std::cout << "write_vtk [s]: " << t.seconds() << std::endl;
         }
 
         Graph graph;
+        std::unique_ptr<ImplicitGraph> implicit_graph; // set in implicit mode, graph holds the nodes only then
 
-        {
+        if (use_implicit_graph) {
             timer<high_resolution_clock> t;
 
-            //create_barycentric_steiner_points(graph, mesh);
-            //std::cout << "create_barycentric_steiner_points: " << t.seconds() << " s" << std::endl;
+            create_steiner_graph_nodes(graph, mesh, yardstick);
+            implicit_graph.reset(new ImplicitGraph(graph, mesh, num_threads));
+            std::cout << "create_steiner_graph_nodes (implicit edges) [s]: " << t.seconds() << std::endl;
+            std::cout << "implicit graph incidences [bytes]: " << implicit_graph->memory() << std::endl;
+        } else {
+            timer<high_resolution_clock> t;
+
+            // the mesh hash is a full pass over the mesh, it is computed once for reading and writing
+            uint64_t hash = use_graph_cache ? mesh_hash(mesh) : 0;
 
-            if (stretch < 0.0) {
-                create_surface_steiner_points(graph, mesh);
-                std::cout << "create_surface_steiner_points [s]: " << t.seconds() << std::endl;
+            if (use_graph_cache && read_graph_cache(graph, mesh, inputfilename.string(), hash, stretch, yardstick)) {
+                std::cout << "read_graph_cache [s]: " << t.seconds() << std::endl;
             } else {
-                std::cout << "create_steiner_graph_improved_spanner with stretch " << stretch << " and interval " << yardstick << std::endl;
-                create_steiner_graph_improved_spanner(graph, mesh, stretch, yardstick);
-                std::cout << "create_steiner_graph_improved_spanner [s]: " << t.seconds() << std::endl;
+                //create_barycentric_steiner_points(graph, mesh);
+                //std::cout << "create_barycentric_steiner_points: " << t.seconds() << " s" << std::endl;
+
+                if (stretch < 0.0) {
+                    create_surface_steiner_points(graph, mesh);
+                    std::cout << "create_surface_steiner_points [s]: " << t.seconds() << std::endl;
+                } else {
+                    std::cout << "create_steiner_graph_improved_spanner with stretch " << stretch << " and interval " << yardstick << std::endl;
+                    create_steiner_graph_improved_spanner(graph, mesh, stretch, yardstick, num_threads);
+                    std::cout << "create_steiner_graph_improved_spanner [s]: " << t.seconds() << std::endl;
+                }
+
+                if (use_graph_cache)
+                    write_graph_cache(graph, mesh, inputfilename.string(), hash, stretch, yardstick);
             }
         }
 
-        print_steiner_point_statistics(mesh);
+        if (!quiet)
+            print_steiner_point_statistics(mesh, num_threads);
 
-        std::cout << "graph nodes: " << graph.m_vertices.size() << std::endl;
-        std::cout << "graph edges: " << graph.m_edges.size() << std::endl;
+        std::cout << "graph nodes: " << num_vertices(graph) << std::endl;
+        std::cout << "graph node arrays [bytes]: " << graph_nodes(graph).memory() << std::endl;
+        std::cout << "graph precision: " << (sizeof(Weight) == sizeof(float) ? "float" : "double") << std::endl;
+        if (implicit_graph)
+            std::cout << "graph edges: implicit" << std::endl;
+        else
+            std::cout << "graph edges: " << num_graph_edges(graph) << std::endl;
+
+        // tiny buckets would run a round per distinct distance
+        if (!implicit_graph && delta > 0 && delta < min_delta(graph)) {
+            cout << "delta " << delta << " is below " << min_delta_fraction << " times the smallest edge weight, exit." << endl;
+            return EXIT_FAILURE;
+        }
 
         if (write_steiner_graph_vtk) {
             timer<high_resolution_clock> t;
-            write_graph_vtk(graph, inputfilename.filename().replace_extension("_steiner_graph.vtk").string());
+            write_graph_vtk(graph, inputfilename.filename().replace_extension("_steiner_graph.vtk").string(), vtk_format);
             std::cout << "write_steiner_graph_vtk [s]: " << t.seconds() << std::endl;
         }
 
         if (start_vertex >= 0 && termination_vertex >= 0) {
-            std::cout << "running single dijkstra for s=" << start_vertex << " and t=" << termination_vertex << std::endl;
+            std::cout << "running single " << query_algorithm_name(algorithm) << " (" << priority_queue_name(queue) << " queue) for s=" << start_vertex << " and t=" << termination_vertex << std::endl;
 
             timer<high_resolution_clock> t;
 
-            double approx_ratio = run_single_dijkstra(graph, mesh, start_vertex, termination_vertex, true, true, true, inputfilename.filename());
+            DijkstraWorkspace workspace(graph);
+            workspace.min_weight = min_weight;
+            workspace.queue = queue;
+            workspace.implicit = implicit_graph.get();
+            double approx_ratio = run_single_dijkstra(graph, mesh, start_vertex, termination_vertex, workspace, algorithm, true, true, true, inputfilename.filename(), vtk_format, num_threads, delta);
 
             std::cout << "total time [s] for " << 1 << " dijkstra_shortest_paths: " << t.seconds() << std::endl;
 
             std::cout << "shortest path approximation ratio: " << approx_ratio << std::endl;
+            std::cout << "settled nodes: " << workspace.settled << std::endl;
         }
 
         if (num_random_s_t_vertices > 0) {
-            std::cout << "running " << num_random_s_t_vertices << " dijkstra for random vertex pairs" << std::endl;
+            num_threads = std::min(worker_threads(num_threads), num_random_s_t_vertices);
+
+            std::cout << "running " << num_random_s_t_vertices << " " << query_algorithm_name(algorithm) << " (" << priority_queue_name(queue) << " queue) for random vertex pairs on " << num_threads << " threads" << std::endl;
 
             std::mt19937 generator;
             // we take only original mesh vertices into account such that computations for different steiner graphs keep comparable
@@ -306,6 +474,7 @@ int main(int argc, char** argv) {
             int max_s;
             int max_t;
             double sum_approx_ratio = 0;
+            double sum_settled_nodes = 0;
 
             timer<high_resolution_clock> t;
 
@@ -317,7 +486,10 @@ int main(int argc, char** argv) {
             std::fill(begin(histo), end(histo), 0);
 
             distance_stream.open("distances.csv", fstream::out | fstream::app);
-            distance_stream << stretch << ", " << yardstick << ", " << graph.m_vertices.size() << ", " << graph.m_edges.size() << ", ";
+            distance_stream << stretch << ", " << yardstick << ", " << num_vertices(graph) << ", " << num_graph_edges(graph) << ", ";
+
+            // draw all pairs up front, so the sequence does not depend on the number of threads
+            std::vector<std::pair<int, int>> s_t_pairs(num_random_s_t_vertices);
 
             for (int i = 0; i < num_random_s_t_vertices; ++i) {
                 int s;
@@ -335,7 +507,37 @@ int main(int argc, char** argv) {
                         t = termination_vertex;
                 } while (s == t);
 
-                double approx_ratio = run_single_dijkstra(graph, mesh, s, t, true, false, false, inputfilename.filename());
+                s_t_pairs[i] = std::make_pair(s, t);
+            }
+
+            std::vector<double> approx_distances(num_random_s_t_vertices);
+            std::vector<double> approx_ratios(num_random_s_t_vertices);
+            std::vector<size_t> settled_nodes(num_random_s_t_vertices);
+
+            // workspaces are allocated lazily by the worker owning it
+            std::vector<DijkstraWorkspace> workspaces(num_threads);
+            for (auto& workspace : workspaces) {
+                workspace.min_weight = min_weight;
+                workspace.queue = queue;
+                workspace.implicit = implicit_graph.get();
+            }
+
+            parallel_for(num_random_s_t_vertices, num_threads, [&](size_t i, int thread) {
+                int s = s_t_pairs[i].first;
+                int t = s_t_pairs[i].second;
+
+                approx_ratios[i] = run_single_dijkstra(graph, mesh, s, t, workspaces[thread], algorithm, true, false, false, inputfilename.filename(), vtk_format);
+                approx_distances[i] = workspaces[thread].distance[t];
+                settled_nodes[i] = workspaces[thread].settled;
+            });
+
+            // statistics are collected in pair order, such that they do not depend on the number of threads
+            for (int i = 0; i < num_random_s_t_vertices; ++i) {
+                int s = s_t_pairs[i].first;
+                int t = s_t_pairs[i].second;
+                double approx_ratio = approx_ratios[i];
+
+                distance_stream << approx_distances[i] << ", ";
 
                 int bin = (int)(num_bins * (approx_ratio - histo_min) / (histo_max - histo_min));
                 if (bin < 0) {
@@ -359,6 +561,7 @@ int main(int argc, char** argv) {
                 }
 
                 sum_approx_ratio += approx_ratio;
+                sum_settled_nodes += settled_nodes[i];
             }
 
             distance_stream << "\n";
@@ -370,12 +573,50 @@ int main(int argc, char** argv) {
             std::cout << "min shortest path approximation ratio: " << min_approx_ratio << " s=" << min_s << " , t=" << min_t << std::endl;
             std::cout << "avg shortest path approximation ratio: " << avg_approx_ratio << std::endl;
             std::cout << "max shortest path approximation ratio: " << max_approx_ratio << " s=" << max_s << " , t=" << max_t << std::endl;
+            std::cout << "avg settled nodes per query: " << sum_settled_nodes / num_random_s_t_vertices << " of " << num_vertices(graph) << std::endl;
 
             for (int bin = 0; bin < num_bins; ++bin) {
                 std::cout << "approx. ratio histo: " << histo_min + bin * ((histo_max - histo_min) / num_bins) << " : " << histo[bin] << std::endl;
             }
         }
 
+        if (!source_vertices.empty()) {
+            std::cout << "running one-to-many dijkstra (" << priority_queue_name(queue) << " queue) from " << source_vertices.size() << " sources to " << target_vertices.size() << " targets" << std::endl;
+
+            timer<high_resolution_clock> t;
+
+            std::vector<GraphNode_descriptor> sources;
+            for (int v : source_vertices)
+                sources.push_back(mesh.v_node(VertexHandle(v)));
+
+            std::vector<GraphNode_descriptor> targets;
+            for (int v : target_vertices)
+                targets.push_back(mesh.v_node(VertexHandle(v)));
+
+            DijkstraWorkspace workspace(graph);
+            workspace.queue = queue;
+            workspace.implicit = implicit_graph.get();
+            dijkstra_to_many(graph, sources, targets, workspace);
+
+            std::cout << "dijkstra_to_many [s]: " << t.seconds() << std::endl;
+            std::cout << "settled nodes: " << workspace.settled << " of " << num_vertices(graph) << std::endl;
+
+            bool binary = (distance_format_name == "binary");
+            std::string filename = inputfilename.filename().replace_extension(binary ? "_distances.bin" : "_distances.csv").string();
+            write_one_to_many_distances(mesh, target_vertices, workspace.distance, binary, filename);
+            std::cout << "distances written to " << filename << std::endl;
+        }
+
+        if (run_server) {
+            std::cout << "query server on stdin" << std::endl;
+
+            DijkstraWorkspace workspace(graph);
+            workspace.min_weight = min_weight;
+            workspace.queue = queue;
+            workspace.implicit = implicit_graph.get();
+            run_query_server(graph, mesh, algorithm, workspace, std::cin, std::cout);
+        }
+
         // write_graph_dot("graph.dot", graph);
 
         std::cout << "This is the end. Total time [s]: " << total_time.seconds() << std::endl;
@@ -399,25 +640,21 @@ double run_single_dijkstra(
     const Mesh& mesh,
     int s_node,
     int t_node,
+    QueryAlgorithm algorithm,
     std::ostream& shortest_path_tree_vtk,
     std::ostream& shortest_path_from_to_vtk,
-    std::ostream& shortest_path_cells_from_to_vtk
+    std::ostream& shortest_path_cells_from_to_vtk,
+    VtkFormat vtk_format
     //std::ostream& cells_tet
 ) {
     // the distances are temporary, so we choose an external property for that
-    std::vector<double> distance(num_vertices(graph));
-    std::vector<GraphNode_descriptor> predecessor(num_vertices(graph));
+    DijkstraWorkspace workspace(graph);
+    // 0 turns A* into plain dijkstra for a mesh without cells
+    workspace.min_weight = mesh._cellWeight.empty() ? 0 : *std::min_element(mesh._cellWeight.begin(), mesh._cellWeight.end());
+    const std::vector<double>& distance = workspace.distance;
+    const std::vector<GraphNode_descriptor>& predecessor = workspace.predecessor;
 
-    boost::dijkstra_shortest_paths(
-        graph,
-        s_node,
-        boost::weight_map(get(&GraphEdge::weight, graph)).distance_map(boost::make_iterator_property_map(distance.begin(), get(boost::vertex_index, graph))).predecessor_map(boost::make_iterator_property_map(predecessor.begin(), get(boost::vertex_index, graph))).distance_inf(std::numeric_limits<double>::infinity()));
-
-    double euclidean_distance = norm(graph[s_node].point, graph[t_node].point);
-    double approx_distance = distance[t_node];
-    double approx_ratio = approx_distance / euclidean_distance;
-
-    distance_stream << approx_distance << ", ";
+    dijkstra(graph, s_node, workspace);
 
     {
         //timer<high_resolution_clock> t;
@@ -427,11 +664,22 @@ double run_single_dijkstra(
             s_node,
             predecessor,
             distance,
-            shortest_path_tree_vtk);
+            shortest_path_tree_vtk,
+            vtk_format);
 
         //std::cout << "write_shortest_path_tree_vtk: " << t.seconds() << " s" << std::endl;
     }
 
+    // the full tree contains the s-t path already, other algorithms run their own query
+    if (algorithm != QUERY_DIJKSTRA)
+        shortest_path_query(graph, s_node, t_node, algorithm, workspace);
+
+    double euclidean_distance = norm(graph_nodes(graph).point(s_node), graph_nodes(graph).point(t_node));
+    double approx_distance = distance[t_node];
+    double approx_ratio = approx_distance / euclidean_distance;
+
+    distance_stream << approx_distance << ", ";
+
     {
         //timer<high_resolution_clock> t;
 
@@ -441,7 +689,8 @@ double run_single_dijkstra(
             t_node,
             predecessor,
             distance,
-            shortest_path_from_to_vtk);
+            shortest_path_from_to_vtk,
+            vtk_format);
 
         //std::cout << "write_shortest_path_to_vtk: " << t.seconds() << " s" << std::endl;
     }
@@ -459,7 +708,8 @@ double run_single_dijkstra(
             t_node,
             predecessor,
             distance,
-            shortest_path_cells_from_to_vtk);
+            shortest_path_cells_from_to_vtk,
+            vtk_format);
         //std::cout << "write_shortest_path_cells_from_to_vtk: " << t.seconds() << " s" << std::endl;
 
         std::set<CellHandle> cells = cells_from_graph_nodes(graph, mesh, s_node, t_node, predecessor);
@@ -484,6 +734,18 @@ int main(int argc, char** argv) {
 #include "wasm.h"
 
 WspResult wsp(const Options& options, const std::string node_text, const std::string ele_text) {
+    QueryAlgorithm algorithm;
+    if (!parse_query_algorithm(options.algorithm, algorithm)) {
+        std::cerr << "unknown algorithm \"" << options.algorithm << "\", using dijkstra" << std::endl;
+        algorithm = QUERY_DIJKSTRA;
+    }
+
+    VtkFormat vtk_format;
+    if (!parse_vtk_format(options.vtk_format, vtk_format)) {
+        std::cerr << "unknown vtk format \"" << options.vtk_format << "\", using ascii" << std::endl;
+        vtk_format = VTK_ASCII;
+    }
+
     Mesh mesh;
 
     std::stringstream node(node_text);
@@ -497,8 +759,7 @@ WspResult wsp(const Options& options, const std::string node_text, const std::st
     if (options.use_random_cellweights) {
         set_random_cell_weights(mesh);
     }
-    calc_face_weights(mesh);
-    calc_edge_weights(mesh);
+    calc_face_and_edge_weights(mesh);
 
     mesh.print_memory_statistics();
     print_mesh_statistics(mesh);
@@ -506,7 +767,7 @@ WspResult wsp(const Options& options, const std::string node_text, const std::st
     std::ostringstream mesh_vtk;
     {
         //timer<high_resolution_clock> t;
-        write_vtk(mesh, mesh_vtk);
+        write_vtk(mesh, mesh_vtk, vtk_format);
         //std::cout << "write_vtk [s]: " << t.seconds() << std::endl;
     }
 
@@ -530,13 +791,13 @@ WspResult wsp(const Options& options, const std::string node_text, const std::st
 
     print_steiner_point_statistics(mesh);
 
-    std::cout << "graph nodes: " << graph.m_vertices.size() << std::endl;
-    std::cout << "graph edges: " << graph.m_edges.size() << std::endl;
+    std::cout << "graph nodes: " << num_vertices(graph) << std::endl;
+    std::cout << "graph edges: " << num_graph_edges(graph) << std::endl;
 
     std::ostringstream steiner_graph_vtk;
     {
         //timer<high_resolution_clock> t;
-        write_graph_vtk(graph, steiner_graph_vtk);
+        write_graph_vtk(graph, steiner_graph_vtk, vtk_format);
         //std::cout << "write_steiner_graph_vtk [s]: " << t.seconds() << std::endl;
     }
 
@@ -561,7 +822,7 @@ WspResult wsp(const Options& options, const std::string node_text, const std::st
 
         //timer<high_resolution_clock> t;
 
-        approx_ratio = run_single_dijkstra(graph, mesh, options.start_vertex, options.termination_vertex, shortest_path_tree_vtk, shortest_path_from_to_vtk, shortest_path_cells_from_to_vtk);
+        approx_ratio = run_single_dijkstra(graph, mesh, options.start_vertex, options.termination_vertex, algorithm, shortest_path_tree_vtk, shortest_path_from_to_vtk, shortest_path_cells_from_to_vtk, vtk_format);
 
         //std::cout << "total time [s] for " << 1 << " dijkstra_shortest_paths: " << t.seconds() << std::endl;
 
@@ -593,7 +854,7 @@ WspResult wsp(const Options& options, const std::string node_text, const std::st
         std::fill(begin(histo), end(histo), 0);
 
         distance_stream.open("distances.csv", fstream::out | fstream::app);
-        distance_stream << options.spanner_stretch << ", " << options.yardstick << ", " << graph.m_vertices.size() << ", " << graph.m_edges.size() << ", ";
+        distance_stream << options.spanner_stretch << ", " << options.yardstick << ", " << num_vertices(graph) << ", " << num_graph_edges(graph) << ", ";
 
         for (int i = 0; i < options.random_s_t_vertices; ++i) {
             int s;
@@ -611,7 +872,7 @@ WspResult wsp(const Options& options, const std::string node_text, const std::st
                     t = options.termination_vertex;
             } while (s == t);
 
-            approx_ratio = run_single_dijkstra(graph, mesh, s, t, shortest_path_tree_vtk, shortest_path_from_to_vtk, shortest_path_cells_from_to_vtk);
+            approx_ratio = run_single_dijkstra(graph, mesh, s, t, algorithm, shortest_path_tree_vtk, shortest_path_from_to_vtk, shortest_path_cells_from_to_vtk, vtk_format);
 
             int bin = (int)(num_bins * (approx_ratio - histo_min) / (histo_max - histo_min));
             if (bin < 0) {
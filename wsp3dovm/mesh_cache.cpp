@@ -0,0 +1,288 @@
+#include "mesh_cache.h"
+
+#ifndef __EMSCRIPTEN__
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+static const char mesh_cache_magic[8] = "wspmesh";
+static const uint32_t mesh_cache_byte_order = 0x01020304;
+
+std::string mesh_cache_filename(const std::string& filename)
+{
+	return filename + ".wspmesh";
+}
+
+// size and word by word hash of a file, reading it is fast compared to parsing it
+static bool file_state(const std::string& filename, uint64_t& size, uint64_t& hash)
+{
+	std::ifstream input(filename, std::ios::binary);
+	if (!input.is_open())
+		return false;
+
+	std::vector<char> buffer(1 << 20);
+	size = 0;
+	hash = 0xCBF29CE484222325ull;
+
+	while (input)
+	{
+		input.read(buffer.data(), buffer.size());
+		size_t n = static_cast<size_t>(input.gcount());
+
+		// the tail of a block is padded with zeros, the size tells the padding apart
+		std::memset(buffer.data() + n, 0, (8 - n % 8) % 8);
+		for (size_t i = 0; i < n; i += 8)
+		{
+			uint64_t word;
+			std::memcpy(&word, buffer.data() + i, sizeof(word));
+			hash = (hash ^ word) * 0x9E3779B97F4A7C15ull;
+			hash ^= hash >> 29;
+		}
+		size += n;
+	}
+
+	return input.eof();
+}
+
+// size and content hash of the tetgen files, returns false if one is missing
+static bool source_files_state(const std::string& filename, MeshCacheHeader& header)
+{
+	return file_state(filename + ".node", header.node_file_size, header.node_file_hash) &&
+		file_state(filename + ".ele", header.ele_file_size, header.ele_file_hash);
+}
+
+// indices in [0,n)
+static bool valid_indices(const int32_t* indices, uint64_t count, uint64_t n)
+{
+	for (uint64_t i = 0; i < count; ++i)
+		if (indices[i] < 0 || static_cast<uint64_t>(indices[i]) >= n)
+			return false;
+	return true;
+}
+
+static uint64_t mesh_cache_size(const MeshCacheHeader& header)
+{
+	return sizeof(MeshCacheHeader)
+		+ sizeof(double) * (3 * header.n_vertices + header.n_cells)
+		+ sizeof(int32_t) * (2 * header.n_edges + 3 * header.n_faces + 4 * header.n_cells);
+}
+
+bool read_mesh_cache(Mesh& mesh, const std::string& filename)
+{
+	std::string cache_filename = mesh_cache_filename(filename);
+
+	if (!boost::filesystem::exists(cache_filename))
+		return false;
+
+	MeshCacheHeader source;
+	if (!source_files_state(filename, source))
+		return false;
+
+	try
+	{
+		boost::interprocess::file_mapping file(cache_filename.c_str(), boost::interprocess::read_only);
+		boost::interprocess::mapped_region region(file, boost::interprocess::read_only);
+
+		const char* data = static_cast<const char*>(region.get_address());
+		size_t size = region.get_size();
+
+		if (size < sizeof(MeshCacheHeader))
+			return false;
+
+		MeshCacheHeader header;
+		std::memcpy(&header, data, sizeof(MeshCacheHeader));
+
+		// each count is bounded by the file size first, so the size sum of a corrupt header cannot wrap around
+		if (std::memcmp(header.magic, mesh_cache_magic, sizeof(header.magic)) != 0 ||
+			header.version != mesh_cache_version ||
+			header.byte_order != mesh_cache_byte_order ||
+			header.n_vertices > size || header.n_edges > size || header.n_faces > size || header.n_cells > size ||
+			mesh_cache_size(header) != size)
+		{
+			std::cout << "read_mesh_cache: ignoring incompatible cache " << cache_filename << std::endl;
+			return false;
+		}
+
+		if (header.node_file_size != source.node_file_size ||
+			header.node_file_hash != source.node_file_hash ||
+			header.ele_file_size != source.ele_file_size ||
+			header.ele_file_hash != source.ele_file_hash)
+		{
+			std::cout << "read_mesh_cache: ignoring outdated cache " << cache_filename << std::endl;
+			return false;
+		}
+
+		const double* vertices = reinterpret_cast<const double*>(data + sizeof(MeshCacheHeader));
+		const double* cell_weights = vertices + 3 * header.n_vertices;
+		const int32_t* edges = reinterpret_cast<const int32_t*>(cell_weights + header.n_cells);
+		const int32_t* faces = edges + 2 * header.n_edges;
+		const int32_t* cells = faces + 3 * header.n_faces;
+
+		// the handles must be in range before they reach the mesh, the topology checks are skipped below.
+		// each edge has two halfedges and each face two halffaces
+		if (header.n_vertices > static_cast<uint64_t>(std::numeric_limits<int32_t>::max()) ||
+			!valid_indices(edges, 2 * header.n_edges, header.n_vertices) ||
+			!valid_indices(faces, 3 * header.n_faces, 2 * header.n_edges) ||
+			!valid_indices(cells, 4 * header.n_cells, 2 * header.n_faces))
+		{
+			std::cout << "read_mesh_cache: ignoring corrupt cache " << cache_filename << std::endl;
+			return false;
+		}
+
+		std::cout << "read_mesh_cache: reading " << cache_filename << " ..." << std::endl;
+
+		// the topology was consistent when the cache was written, so all searches and checks are skipped
+		mesh.enable_bottom_up_incidences(false);
+
+		for (uint64_t i = 0; i < header.n_vertices; ++i)
+		{
+			mesh.add_vertex(Point(vertices[3 * i], vertices[3 * i + 1], vertices[3 * i + 2]));
+		}
+
+		for (uint64_t i = 0; i < header.n_edges; ++i)
+		{
+			mesh.add_edge(VertexHandle(edges[2 * i]), VertexHandle(edges[2 * i + 1]), true);
+		}
+
+		std::vector<HalfEdgeHandle> halfedges(3);
+		for (uint64_t i = 0; i < header.n_faces; ++i)
+		{
+			for (int k = 0; k < 3; ++k)
+				halfedges[k] = HalfEdgeHandle(faces[3 * i + k]);
+			mesh.add_face(halfedges, false);
+		}
+
+		std::vector<HalfFaceHandle> halffaces(4);
+		for (uint64_t i = 0; i < header.n_cells; ++i)
+		{
+			for (int k = 0; k < 4; ++k)
+				halffaces[k] = HalfFaceHandle(cells[4 * i + k]);
+			mesh.add_cell(halffaces, false);
+		}
+
+		mesh._cellWeight.assign(cell_weights, cell_weights + header.n_cells);
+
+		// same incidences as read_tet builds
+		mesh.enable_vertex_bottom_up_incidences(true);
+		mesh.enable_edge_bottom_up_incidences(true);
+		mesh.enable_face_bottom_up_incidences(true);
+	}
+	catch (const boost::interprocess::interprocess_exception& e)
+	{
+		std::cerr << "read_mesh_cache: failed to map " << cache_filename << ": " << e.what() << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+bool write_mesh_cache(const Mesh& mesh, const std::string& filename)
+{
+	std::string cache_filename = mesh_cache_filename(filename);
+
+	MeshCacheHeader header;
+	std::memset(&header, 0, sizeof(header));
+	std::memcpy(header.magic, mesh_cache_magic, sizeof(header.magic));
+	header.version = mesh_cache_version;
+	header.byte_order = mesh_cache_byte_order;
+	header.n_vertices = mesh.n_vertices();
+	header.n_edges = mesh.n_edges();
+	header.n_faces = mesh.n_faces();
+	header.n_cells = mesh.n_cells();
+
+	if (!source_files_state(filename, header))
+		return false;
+
+	std::vector<double> vertices;
+	vertices.reserve(3 * header.n_vertices);
+	for (auto it = mesh.vertices_begin(); it != mesh.vertices_end(); ++it)
+	{
+		Point p = mesh.vertex(*it);
+		vertices.push_back(p[0]);
+		vertices.push_back(p[1]);
+		vertices.push_back(p[2]);
+	}
+
+	std::vector<int32_t> edges;
+	edges.reserve(2 * header.n_edges);
+	for (auto it = mesh.edges_begin(); it != mesh.edges_end(); ++it)
+	{
+		Edge e = mesh.edge(*it);
+		edges.push_back(e.from_vertex().idx());
+		edges.push_back(e.to_vertex().idx());
+	}
+
+	std::vector<int32_t> faces;
+	faces.reserve(3 * header.n_faces);
+	for (auto it = mesh.faces_begin(); it != mesh.faces_end(); ++it)
+	{
+		const std::vector<HalfEdgeHandle>& halfedges = mesh.face(*it).halfedges();
+		if (halfedges.size() != 3)
+			return false; // not a tetrahedral mesh
+
+		for (auto heh : halfedges)
+			faces.push_back(heh.idx());
+	}
+
+	std::vector<int32_t> cells;
+	cells.reserve(4 * header.n_cells);
+	for (auto it = mesh.cells_begin(); it != mesh.cells_end(); ++it)
+	{
+		const std::vector<HalfFaceHandle>& halffaces = mesh.cell(*it).halffaces();
+		if (halffaces.size() != 4)
+			return false; // not a tetrahedral mesh
+
+		for (auto hfh : halffaces)
+			cells.push_back(hfh.idx());
+	}
+
+	if (mesh._cellWeight.size() != header.n_cells)
+		return false;
+
+	// concurrent runs on the same mesh must not see a partial file, nor write to the same temporary file.
+	// the last rename wins, the files are equal anyway
+	std::string temp_filename = cache_filename + "." + boost::filesystem::unique_path().string() + ".tmp";
+	{
+		std::ofstream output(temp_filename, std::ios::binary);
+		if (!output.is_open())
+		{
+			std::cerr << "write_mesh_cache: failed to open " << temp_filename << std::endl;
+			return false;
+		}
+
+		output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		output.write(reinterpret_cast<const char*>(vertices.data()), sizeof(double) * vertices.size());
+		output.write(reinterpret_cast<const char*>(mesh._cellWeight.data()), sizeof(double) * mesh._cellWeight.size());
+		output.write(reinterpret_cast<const char*>(edges.data()), sizeof(int32_t) * edges.size());
+		output.write(reinterpret_cast<const char*>(faces.data()), sizeof(int32_t) * faces.size());
+		output.write(reinterpret_cast<const char*>(cells.data()), sizeof(int32_t) * cells.size());
+
+		if (!output)
+		{
+			std::cerr << "write_mesh_cache: failed to write " << temp_filename << std::endl;
+			output.close();
+			boost::system::error_code ignored;
+			boost::filesystem::remove(temp_filename, ignored);
+			return false;
+		}
+	}
+
+	boost::system::error_code error;
+	boost::filesystem::rename(temp_filename, cache_filename, error);
+	if (error)
+	{
+		std::cerr << "write_mesh_cache: failed to rename " << temp_filename << ": " << error.message() << std::endl;
+		boost::system::error_code ignored;
+		boost::filesystem::remove(temp_filename, ignored);
+		return false;
+	}
+
+	std::cout << "write_mesh_cache: wrote " << cache_filename << std::endl;
+	return true;
+}
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include "common.h"
+
+// binary cache of a mesh read from tetgen files.
+// the file holds the vertices, the edge, face and cell topology and the cell weights in flat arrays
+// which are memory mapped on load, so neither text parsing nor face matching is needed.
+// the bottom-up incidences are owned by OpenVolumeMesh, they are rebuilt in linear time on load.
+//
+// layout: MeshCacheHeader, then 8 byte aligned
+//   double  vertices[3 * n_vertices]
+//   double  cell_weights[n_cells]
+//   int32_t edges[2 * n_edges]			from and to vertex
+//   int32_t faces[3 * n_faces]			halfedges
+//   int32_t cells[4 * n_cells]			halffaces
+
+const uint32_t mesh_cache_version = 2;
+
+struct MeshCacheHeader
+{
+	char magic[8];				// "wspmesh"
+	uint32_t version;			// mesh_cache_version
+	uint32_t byte_order;		// 0x01020304 as written by the producing machine
+
+	uint64_t n_vertices;
+	uint64_t n_edges;
+	uint64_t n_faces;
+	uint64_t n_cells;
+
+	// the tetgen files the cache was made from, the cache is outdated if their contents change.
+	// modification times are not used, they have a resolution of seconds
+	uint64_t node_file_size;
+	uint64_t node_file_hash;
+	uint64_t ele_file_size;
+	uint64_t ele_file_hash;
+};
+
+// cache file name for tetgen files (without extension)
+std::string mesh_cache_filename(const std::string& filename);
+
+// reads the mesh from the cache of the tetgen files filename (without extension) into an empty mesh.
+// returns false if there is no cache or it is outdated, unreadable or corrupt, mesh is untouched then.
+bool read_mesh_cache(Mesh& mesh, const std::string& filename);
+
+// writes the cache for a mesh read from the tetgen files filename (without extension), returns false on failure
+bool write_mesh_cache(const Mesh& mesh, const std::string& filename);
+
+#endif
@@ -0,0 +1,213 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// number of worker threads to use, 0 or less means all hardware threads
+inline int worker_threads(int requested)
+{
+#ifdef __EMSCRIPTEN__
+	// wasm is built without pthreads
+	return 1;
+#else
+	if (requested > 0)
+		return requested;
+
+	int hardware = static_cast<int>(std::thread::hardware_concurrency());
+	return std::max(hardware, 1);
+#endif
+}
+
+// calls body(i, thread) for each i in [0,n) on a pool of num_threads workers.
+// indices are handed out one by one, so expensive and cheap items mix well.
+// thread is in [0,num_threads) and can be used to pick per-thread buffers.
+template <class Body>
+void parallel_for(size_t n, int num_threads, Body body)
+{
+	num_threads = std::min(worker_threads(num_threads), static_cast<int>(std::max<size_t>(n, 1)));
+
+	if (num_threads == 1)
+	{
+		for (size_t i = 0; i < n; ++i)
+			body(i, 0);
+		return;
+	}
+
+	std::atomic<size_t> next(0);
+
+	auto worker = [&](int thread)
+	{
+		for (size_t i = next++; i < n; i = next++)
+			body(i, thread);
+	};
+
+	std::vector<std::thread> pool;
+	for (int thread = 1; thread < num_threads; ++thread)
+		pool.emplace_back(worker, thread);
+
+	worker(0);
+
+	for (auto& t : pool)
+		t.join();
+}
+
+// the bits of non-negative doubles compare like the doubles,
+// so the minimum of doubles can be taken by an atomic integer compare and swap
+inline uint64_t ordered_bits(double value)
+{
+	uint64_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+inline double ordered_double(uint64_t bits)
+{
+	double value;
+	std::memcpy(&value, &bits, sizeof(value));
+	return value;
+}
+
+// lowers value to bits if bits is smaller, returns whether it did
+inline bool atomic_min(std::atomic<uint64_t>& value, uint64_t bits)
+{
+	uint64_t old = value.load(std::memory_order_relaxed);
+	while (bits < old)
+	{
+		if (value.compare_exchange_weak(old, bits, std::memory_order_relaxed))
+			return true;
+	}
+	return false;
+}
+
+// calls body(begin, end, thread) for the consecutive ranges [begin,end) of chunk_size indices in [0,n),
+// for loops over millions of cheap items
+template <class Body>
+void parallel_for_chunks(size_t n, size_t chunk_size, int num_threads, Body body)
+{
+	size_t num_chunks = (n + chunk_size - 1) / chunk_size;
+
+	parallel_for(num_chunks, num_threads, [&](size_t chunk, int thread)
+	{
+		size_t begin = chunk * chunk_size;
+		body(begin, std::min(begin + chunk_size, n), thread);
+	});
+}
+
+// num_threads - 1 worker threads that are started once and wait for loops to run, the calling thread is the first worker.
+// for algorithms that run many short parallel loops in a row, where parallel_for would start threads for each loop.
+class ThreadPool
+{
+public:
+	explicit ThreadPool(int num_threads) : task_size(0), next(0), generation(0), busy(0), stop(false)
+	{
+		for (int thread = 1; thread < worker_threads(num_threads); ++thread)
+			workers.emplace_back(&ThreadPool::work, this, thread);
+	}
+
+	~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stop = true;
+		}
+		wake.notify_all();
+
+		for (auto& t : workers)
+			t.join();
+	}
+
+	int size() const { return static_cast<int>(workers.size()) + 1; }
+
+	// same as the free parallel_for with the threads of the pool
+	template <class Body>
+	void parallel_for(size_t n, Body body)
+	{
+		if (workers.empty() || n <= 1)
+		{
+			for (size_t i = 0; i < n; ++i)
+				body(i, 0);
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			task = body;
+			task_size = n;
+			next = 0;
+			busy = static_cast<int>(workers.size());
+			++generation;
+		}
+		wake.notify_all();
+
+		run(0);
+
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [this] { return busy == 0; });
+		task = nullptr;
+	}
+
+	// same as the free parallel_for_chunks with the threads of the pool
+	template <class Body>
+	void parallel_for_chunks(size_t n, size_t chunk_size, Body body)
+	{
+		size_t num_chunks = (n + chunk_size - 1) / chunk_size;
+
+		parallel_for(num_chunks, [&](size_t chunk, int thread)
+		{
+			size_t begin = chunk * chunk_size;
+			body(begin, std::min(begin + chunk_size, n), thread);
+		});
+	}
+
+private:
+	void run(int thread)
+	{
+		for (size_t i = next++; i < task_size; i = next++)
+			task(i, thread);
+	}
+
+	void work(int thread)
+	{
+		uint64_t seen = 0;
+		for (;;)
+		{
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [&] { return stop || generation != seen; });
+				if (stop)
+					return;
+				seen = generation;
+			}
+
+			run(thread);
+
+			std::lock_guard<std::mutex> lock(mutex);
+			if (--busy == 0)
+				done.notify_one();
+		}
+	}
+
+	std::vector<std::thread> workers;
+
+	std::mutex mutex;
+	std::condition_variable wake;	// a loop is ready or the pool stops
+	std::condition_variable done;	// all workers finished the loop
+
+	std::function<void(size_t, int)> task;
+	size_t task_size;
+	std::atomic<size_t> next;
+	uint64_t generation;
+	int busy;
+	bool stop;
+};
+
+#endif
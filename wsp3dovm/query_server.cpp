@@ -0,0 +1,200 @@
+#include "query_server.h"
+
+#include <algorithm>
+#include <limits>
+#include <sstream>
+
+// maps a mesh vertex number to its graph node, false if there is no such vertex
+static bool vertex_node(const Mesh& mesh, int vertex, GraphNode_descriptor& node)
+{
+	if (vertex < 0 || vertex >= static_cast<int>(mesh.n_vertices()))
+		return false;
+
+	node = mesh.v_node(VertexHandle(vertex));
+	return true;
+}
+
+static bool read_vertex(std::istream& query, const Mesh& mesh, GraphNode_descriptor& node)
+{
+	int vertex;
+	return (query >> vertex) && vertex_node(mesh, vertex, node);
+}
+
+static void write_distance(std::ostream& output, double distance)
+{
+	if (std::isfinite(distance))
+		output << distance;
+	else
+		output << "inf";
+}
+
+// the path nodes from s to t, empty if t is unreachable
+static std::vector<GraphNode_descriptor> path_from_to(const DijkstraWorkspace& workspace, GraphNode_descriptor s, GraphNode_descriptor t)
+{
+	std::vector<GraphNode_descriptor> nodes;
+	if (!std::isfinite(workspace.distance[t]))
+		return nodes;
+
+	for (GraphNode_descriptor r = t; r != s; r = workspace.predecessor[r])
+		nodes.push_back(r);
+	nodes.push_back(s);
+
+	std::reverse(nodes.begin(), nodes.end());
+	return nodes;
+}
+
+void run_query_server
+(
+	const Graph& graph,
+	const Mesh& mesh,
+	QueryAlgorithm algorithm,
+	DijkstraWorkspace& workspace,
+	std::istream& input,
+	std::ostream& output
+)
+{
+	workspace.resize(graph);
+
+	// distances are printed such that they read back exactly
+	output.precision(std::numeric_limits<double>::max_digits10);
+
+	// anything before is log output
+	output << "ready\n" << std::flush;
+
+	std::string line;
+	while (std::getline(input, line))
+	{
+		std::istringstream query(line);
+		std::string command;
+		if (!(query >> command))
+			continue;
+
+		if (command == "quit")
+			break;
+
+		if (command == "algorithm")
+		{
+			std::string name;
+			QueryAlgorithm requested;
+			if (!(query >> name && parse_query_algorithm(name, requested)))
+				output << "error unknown algorithm";
+			else if (workspace.implicit && requested != QUERY_DIJKSTRA)
+				output << "error the implicit graph supports dijkstra only";
+			else
+			{
+				algorithm = requested;
+				output << "algorithm " << query_algorithm_name(algorithm);
+			}
+		}
+		else if (command == "queue")
+		{
+			std::string name;
+			PriorityQueue requested;
+			if (!(query >> name && parse_priority_queue(name, requested)))
+				output << "error unknown queue";
+			else if (workspace.implicit && requested == QUEUE_BOOST)
+				output << "error the implicit graph needs the binary or radix queue";
+			else
+			{
+				workspace.queue = requested;
+				output << "queue " << priority_queue_name(workspace.queue);
+			}
+		}
+		else if (command == "st" || command == "path" || command == "cells")
+		{
+			GraphNode_descriptor s;
+			GraphNode_descriptor t;
+			if (!read_vertex(query, mesh, s) || !read_vertex(query, mesh, t))
+			{
+				output << "error " << command << " needs two mesh vertex numbers\n" << std::flush;
+				continue;
+			}
+
+			shortest_path_query(graph, s, t, algorithm, workspace);
+			double distance = workspace.distance[t];
+
+			if (command == "st")
+			{
+				output << "distance ";
+				write_distance(output, distance);
+				output << " " << workspace.settled;
+			}
+			else if (command == "path")
+			{
+				std::vector<GraphNode_descriptor> nodes = path_from_to(workspace, s, t);
+
+				output << "path ";
+				write_distance(output, distance);
+				output << " " << nodes.size();
+				for (GraphNode_descriptor u : nodes)
+				{
+					Point p = graph_nodes(graph).point(u);
+					output << " " << p[0] << " " << p[1] << " " << p[2];
+				}
+			}
+			else
+			{
+				std::set<CellHandle> cells;
+				if (std::isfinite(distance))
+					cells = cells_from_graph_nodes(graph, mesh, s, t, workspace.predecessor);
+
+				output << "cells ";
+				write_distance(output, distance);
+				output << " " << cells.size();
+				for (CellHandle ch : cells)
+					output << " " << ch.idx();
+			}
+		}
+		else if (command == "sssp")
+		{
+			GraphNode_descriptor s;
+			if (!read_vertex(query, mesh, s))
+			{
+				output << "error sssp needs a mesh vertex number\n" << std::flush;
+				continue;
+			}
+
+			std::vector<GraphNode_descriptor> targets;
+			bool valid = true;
+			int vertex;
+			while (query >> vertex)
+			{
+				GraphNode_descriptor t = 0;
+				valid = valid && vertex_node(mesh, vertex, t);
+				targets.push_back(t);
+			}
+
+			if (!valid || !query.eof())
+			{
+				output << "error sssp targets must be mesh vertex numbers\n" << std::flush;
+				continue;
+			}
+
+			if (targets.empty())
+			{
+				for (int v = 0; v < static_cast<int>(mesh.n_vertices()); ++v)
+					targets.push_back(mesh.v_node(VertexHandle(v)));
+
+				dijkstra(graph, s, workspace);
+			}
+			else
+			{
+				// one search that stops when the last of the given targets is settled
+				dijkstra_to_many(graph, std::vector<GraphNode_descriptor>(1, s), targets, workspace);
+			}
+
+			output << "sssp " << targets.size();
+			for (GraphNode_descriptor u : targets)
+			{
+				output << " ";
+				write_distance(output, workspace.distance[u]);
+			}
+		}
+		else
+		{
+			output << "error unknown command " << command;
+		}
+
+		output << "\n" << std::flush;
+	}
+}
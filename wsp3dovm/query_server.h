@@ -0,0 +1,30 @@
+#ifndef QUERY_SERVER_H
+#define QUERY_SERVER_H
+
+#include "common.h"
+#include "dijkstra.h"
+
+// answers shortest path queries read line by line from input until "quit" or the end of input,
+// one answer line per query is written to output and flushed. vertices are mesh vertex numbers.
+// the server starts by writing a "ready" line, so clients can skip the log output before it.
+//
+//   st <s> <t>              distance <d> <settled nodes>
+//   path <s> <t>            path <d> <n> followed by the n points x y z from s to t
+//   cells <s> <t>           cells <d> <n> followed by the n mesh cell numbers along the path
+//   sssp <s> [<t> ...]      sssp <n> followed by the distances to the given or else all mesh vertices
+//   algorithm <name>        algorithm <name>, sets the s-t query algorithm
+//   queue <name>            queue <name>, sets the priority queue of the dijkstra searches
+//   quit
+//
+// unreachable vertices have distance inf, malformed queries are answered with "error <message>".
+void run_query_server
+(
+	const Graph& graph,
+	const Mesh& mesh,
+	QueryAlgorithm algorithm,
+	DijkstraWorkspace& workspace,
+	std::istream& input,
+	std::ostream& output
+);
+
+#endif
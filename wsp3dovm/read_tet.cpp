@@ -1,14 +1,28 @@
 #include "read_tet.h"
 
 #include "MeshGenerator.hpp"
+#include "mesh_cache.h"
+#include "parallel.h"
 
+#include <algorithm>
+#include <charconv>
+#include <cstdlib>
 #include <fstream>
+#include <iterator>
+#include <string>
+
+#ifndef __EMSCRIPTEN__
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#endif
 
 // starting with tetgen 1.5.1 beta, there are additional new file formats containing 
 // top-down topological information
 // We also tried to save (cache) the topology in .ovm file format and usethat later.
 // However, even this did not shortcut running time because bottom-up data structures
 // have to be generated in memory anyway.
+// The binary cache (mesh_cache.h) does: it skips the text parsing and the face and edge matching
+// of MeshGenerator, the bottom-up incidences are computed in a single pass each.
 
 // internally we start at index 0 so we need correction info
 // the start value depends on the software, there is no standard
@@ -17,125 +31,351 @@ int first_edge_number = 0;
 int first_facet_number = 0;
 int first_tetra_number = 0;
 
+// one line of tetgen text with the comment ('#' up to the end of the line) removed
+struct TetgenLine
+{
+	const char* pos;
+	const char* end;
+
+	bool empty()
+	{
+		skip_blanks();
+		return pos == end;
+	}
+
+	// parses the next integer on the line, no locale and no copy
+	template <class T>
+	bool read(T& value)
+	{
+		const char* first = number_begin();
+		std::from_chars_result result = std::from_chars(first, end, value);
+		if (result.ec != std::errc())
+			return false;
+		pos = result.ptr;
+		return true;
+	}
+
+	// parses the next real on the line, with from_chars where the standard library has it for
+	// floating types and with strtod on a copy of the number otherwise (older libc++, emscripten)
+	bool read(double& value)
+	{
+		const char* first = number_begin();
+#ifdef __cpp_lib_to_chars
+		std::from_chars_result result = std::from_chars(first, end, value);
+		if (result.ec != std::errc())
+			return false;
+		pos = result.ptr;
+#else
+		// the mapped file is not null terminated
+		char number[64];
+		size_t length = std::find_if(first, end, [](char c) { return c == ' ' || c == '\t' || c == '\r'; }) - first;
+		if (length == 0 || length >= sizeof(number))
+			return false;
+		std::copy(first, first + length, number);
+		number[length] = '\0';
+		char* number_end;
+		value = std::strtod(number, &number_end);
+		if (number_end == number)
+			return false;
+		pos = first + (number_end - number);
+#endif
+		return true;
+	}
+
+	// skips the blanks and a leading '+', which from_chars does not take but tetgen input may have
+	const char* number_begin()
+	{
+		skip_blanks();
+		if (pos != end && *pos == '+' && pos + 1 != end && pos[1] != '-' && pos[1] != '+')
+			return pos + 1;
+		return pos;
+	}
+
+	void skip_blanks()
+	{
+		while (pos != end && (*pos == ' ' || *pos == '\t' || *pos == '\r'))
+			++pos;
+	}
+};
+
+// finds the next line in [pos,end) which is not empty or a comment and advances pos behind it
+static bool next_line(const char*& pos, const char* end, TetgenLine& line)
+{
+	while (pos != end)
+	{
+		const char* eol = std::find(pos, end, '\n');
+		line.pos = pos;
+		line.end = std::find(pos, eol, '#');
+		pos = (eol == end) ? end : eol + 1;
+
+		if (!line.empty())
+			return true;
+	}
+	return false;
+}
+
+// parses the record lines in [begin,end) with parse(line, record) on up to num_threads threads.
+// the text is split into chunks at line boundaries, the records of all chunks are concatenated in order.
+// returns false and the offending line if a line could not be parsed.
+template <class Record, class Parse>
+static bool parse_records(const char* begin, const char* end, int num_threads, Parse parse, std::vector<Record>& records, std::string& error_line)
+{
+	// small inputs are not worth starting threads
+	const size_t min_chunk_size = 1 << 20;
+
+	size_t size = end - begin;
+	size_t num_chunks = std::max<size_t>(1, std::min<size_t>(worker_threads(num_threads), size / min_chunk_size));
+
+	std::vector<const char*> chunk_begin(num_chunks + 1, end);
+	chunk_begin[0] = begin;
+	for (size_t i = 1; i < num_chunks; ++i)
+	{
+		const char* split = std::max(chunk_begin[i - 1], begin + i * size / num_chunks);
+		split = std::find(split, end, '\n');
+		chunk_begin[i] = (split == end) ? end : split + 1;
+	}
+
+	std::vector<std::vector<Record>> chunk_records(num_chunks);
+	std::vector<std::string> chunk_errors(num_chunks);
+
+	parallel_for(num_chunks, static_cast<int>(num_chunks), [&](size_t i, int)
+	{
+		const char* pos = chunk_begin[i];
+		const char* chunk_end = chunk_begin[i + 1];
+		std::vector<Record>& result = chunk_records[i];
+		result.reserve((chunk_end - pos) / 32);
+
+		TetgenLine line;
+		while (next_line(pos, chunk_end, line))
+		{
+			Record record;
+			TetgenLine parsed = line;
+			if (!parse(parsed, record))
+			{
+				chunk_errors[i].assign(line.pos, line.end);
+				return;
+			}
+			result.push_back(record);
+		}
+	});
+
+	for (size_t i = 0; i < num_chunks; ++i)
+	{
+		if (!chunk_errors[i].empty())
+		{
+			error_line = chunk_errors[i];
+			return false;
+		}
+	}
+
+	size_t total = 0;
+	for (const auto& chunk : chunk_records)
+		total += chunk.size();
+
+	records.clear();
+	records.reserve(total);
+	for (auto& chunk : chunk_records)
+	{
+		records.insert(records.end(), chunk.begin(), chunk.end());
+		std::vector<Record>().swap(chunk);
+	}
+
+	return true;
+}
+
+struct TetgenNode
+{
+	int number;
+	double x;
+	double y;
+	double z;
+};
+
+struct TetgenTetra
+{
+	int number;
+	int vertex[4];
+	double weight;
+};
+
 // make nodes from point input, add them to mesh and keep 0-based indices in vector
-void read_nodes(MeshGenerator &meshGenerator, std::istream& input)
+static void read_nodes(MeshGenerator &meshGenerator, const char* begin, const char* end, int num_threads)
 {
 	int number_of_nodes;
 	int dimension;
 	int number_of_attributes;
-	bool has_boundary_marker;
+	int has_boundary_marker;
 
 	// file format see http://tetgen.berlios.de/fformats.node.html
-	input >> number_of_nodes >> dimension >> number_of_attributes >> has_boundary_marker;
+	TetgenLine header;
+	if (!next_line(begin, end, header) || !header.read(number_of_nodes) || !header.read(dimension) || !header.read(number_of_attributes) || !header.read(has_boundary_marker))
+	{
+		std::cerr << "read_tet: failed to read node header, exiting" << std::endl;
+		exit(EXIT_FAILURE);
+	}
 	if (dimension != 3)
 	{
 		std::cerr << "read_tet: wrong dimension found in node input, exiting" << std::endl;
 		exit(EXIT_FAILURE);
 	}
 	std::cout << "  reading " << number_of_nodes << " nodes..." << std::endl;
-	for (int i = 0; i < number_of_nodes; ++i)
+
+	// attributes and boundary marker following the coordinates are ignored
+	auto parse = [](TetgenLine& line, TetgenNode& node)
 	{
-		int j;
-		double x;
-		double y;
-		double z;
+		return line.read(node.number) && line.read(node.x) && line.read(node.y) && line.read(node.z);
+	};
 
-		if (!(input >> j >> x >> y >> z))
-		{
-			std::cerr << "read_tet: failed to read node " << i << std::endl;
-			exit(EXIT_FAILURE);
-		}
+	std::vector<TetgenNode> nodes;
+	std::string error_line;
+	if (!parse_records<TetgenNode>(begin, end, num_threads, parse, nodes, error_line))
+	{
+		std::cerr << "read_tet: failed to read node \"" << error_line << "\"" << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	if (nodes.size() != static_cast<size_t>(number_of_nodes))
+	{
+		std::cerr << "read_tet: " << number_of_nodes << " nodes expected, found " << nodes.size() << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	for (int i = 0; i < number_of_nodes; ++i)
+	{
+		const TetgenNode& node = nodes[i];
 
 		if (i == 0)
 		{
-			first_point_number = j;
+			first_point_number = node.number;
 		}
 		else
 		{
-			assert(i + first_point_number == j);
+			assert(i + first_point_number == node.number);
 		}
 
-		meshGenerator.add_vertex_component(x);
-		meshGenerator.add_vertex_component(y);
-		meshGenerator.add_vertex_component(z);
-
-		// attributes, ignored
-		for (int k = 0; k < number_of_attributes; ++ k) 
-			input >> j;
-
-		// boundary_marker, ignored
-		if (has_boundary_marker)
-			input >> j;
+		meshGenerator.add_vertex_component(node.x);
+		meshGenerator.add_vertex_component(node.y);
+		meshGenerator.add_vertex_component(node.z);
 	}
 }
 
-void read_tetras( MeshGenerator &meshGenerator, std::istream& input)
+static void read_tetras(MeshGenerator &meshGenerator, const char* begin, const char* end, int num_threads)
 {
 	int number_of_tetras;
 	int number_of_points;
-	bool has_boundary_marker;
+	int has_boundary_marker;
 
 	// file format see 
-	input >> number_of_tetras >> number_of_points >> has_boundary_marker;
+	TetgenLine header;
+	if (!next_line(begin, end, header) || !header.read(number_of_tetras) || !header.read(number_of_points) || !header.read(has_boundary_marker))
+	{
+		std::cerr << "failed to read tetra header, exit" << std::endl;
+		exit(EXIT_FAILURE);
+	}
 	if (number_of_points != 4)
 	{
 		std::cerr << "number of points 4 expected, found " << number_of_points << ", exit" << std::endl;
 		exit(EXIT_FAILURE);
 	}
 	std::cout << "  reading " << number_of_tetras << " tetras..." << std::endl;
-	for (int i = 0; i < number_of_tetras; ++i)
+
+	// the (first) region attribute is the weight
+	auto parse = [has_boundary_marker](TetgenLine& line, TetgenTetra& tetra)
 	{
-		int j;
-		int u;
-		int v;
-		int w;
-		int x;
-		if (!(input >> j >> u >> v >> w >> x))
+		if (!line.read(tetra.number))
+			return false;
+		for (int k = 0; k < 4; ++k)
 		{
-			std::cerr << "failed to read tetra " << i << std::endl;
-			exit(EXIT_FAILURE);
+			if (!line.read(tetra.vertex[k]))
+				return false;
 		}
-	
+
+		if (has_boundary_marker)
+			return line.read(tetra.weight);
+
+		tetra.weight = 1.0;
+		return true;
+	};
+
+	std::vector<TetgenTetra> tetras;
+	std::string error_line;
+	if (!parse_records<TetgenTetra>(begin, end, num_threads, parse, tetras, error_line))
+	{
+		std::cerr << "failed to read tetra \"" << error_line << "\"" << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	if (tetras.size() != static_cast<size_t>(number_of_tetras))
+	{
+		std::cerr << number_of_tetras << " tetras expected, found " << tetras.size() << ", exit" << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	std::vector<VertexHandle> cell_vertices;
+	cell_vertices.reserve(4 * static_cast<size_t>(number_of_tetras));
+	meshGenerator.mesh()._cellWeight.reserve(number_of_tetras);
+
+	for (int i = 0; i < number_of_tetras; ++i)
+	{
+		const TetgenTetra& tetra = tetras[i];
+
 		if (i == 0)
 		{
-			first_tetra_number = j;
+			first_tetra_number = tetra.number;
 		}
 		else
 		{
-			assert(i + first_tetra_number == j);
+			assert(i + first_tetra_number == tetra.number);
 		}
 
-		u -= first_point_number;
-		v -= first_point_number;
-		w -= first_point_number;
-		x -= first_point_number;
-
-		meshGenerator.add_cell_vertex(u + 1);
-		meshGenerator.add_cell_vertex(v + 1);
-		meshGenerator.add_cell_vertex(w + 1);
-		meshGenerator.add_cell_vertex(x + 1);
-
-		// weight
-		double weight;
-		if (has_boundary_marker)
-		{
-			input >> weight;
-		}
-		else
+		for (int k = 0; k < 4; ++k)
 		{
-			weight = 1.0;
+			cell_vertices.push_back(VertexHandle(tetra.vertex[k] - first_point_number));
 		}
-		meshGenerator.mesh()._cellWeight.push_back(weight);
+
+		meshGenerator.mesh()._cellWeight.push_back(tetra.weight);
 	}
+	std::vector<TetgenTetra>().swap(tetras);
+
+	// all faces are matched at once, see MeshGenerator::add_tetrahedral_cells
+	meshGenerator.add_tetrahedral_cells(cell_vertices);
+}
+
+static void read_tet(Mesh& mesh, const char* node_begin, const char* node_end, const char* ele_begin, const char* ele_end, int num_threads)
+{
+	MeshGenerator generator(mesh);
+
+	// all nodes
+	std::cout << "  read_nodes..." << std::endl;
+	read_nodes(generator, node_begin, node_end, num_threads);
+
+	// these are only the boundary edges
+	// read_edges ( edges, "C:/Carleton/CGAL-4.4/demo/Polyhedron/data/ellipsoid.1.edge");
+
+	// these are only the boundary facets
+	// read_facets(facets, "C:/Carleton/CGAL-4.4/demo/Polyhedron/data/ellipsoid.1.face");
+
+	// all tetrahedra
+	// the bulk construction in MeshGenerator::add_tetrahedral_cells needs no incidences while
+	// adding edges, faces and cells (an incremental add_edge without vertex incidences makes an
+	// expensive quadratic search). it enables all bottom-up incidences at the end, they are needed
+	// for vc_iter and other iterators later on.
+	std::cout << "  read_tetras..." << std::endl;
+	read_tetras(generator, ele_begin, ele_end, num_threads);
+
+	std::cout << "read_tet finished." << std::endl;
 }
 
-void read_tet(Mesh &mesh, std::string filename)
+void read_tet(Mesh &mesh, std::string filename, bool use_cache, int num_threads)
 {
+#ifndef __EMSCRIPTEN__
+	if (use_cache && read_mesh_cache(mesh, filename))
+		return;
+#endif
+
 	boost::filesystem::path input_pathname = filename;
 	
 	std::cout << "read_tet: slurping tetraheder soup from " << filename << " ..." << std::endl;
-	MeshGenerator generator(mesh);
 
+#ifdef __EMSCRIPTEN__
 	std::ifstream node_file(input_pathname.string() + ".node");
 	if (!node_file.is_open())
 	{
@@ -151,47 +391,46 @@ void read_tet(Mesh &mesh, std::string filename)
 	}
 
 	read_tet(mesh, node_file, tetra_file);
-}
-
-void read_tet(Mesh& mesh, std::istream& node, std::istream& ele)
-{
-	MeshGenerator generator(mesh);
-
-	// all nodes
-	std::cout << "  read_nodes..." << std::endl;
-	read_nodes(generator, node);
-
-	// these are only the boundary edges
-	// read_edges ( edges, "C:/Carleton/CGAL-4.4/demo/Polyhedron/data/ellipsoid.1.edge");
-
-	// these are only the boundary facets
-	// read_facets(facets, "C:/Carleton/CGAL-4.4/demo/Polyhedron/data/ellipsoid.1.face");
-
-	// all tetrahedra
-
-	std::cout << "  enable_bottom_up_incidences(false)..." << std::endl;
-	mesh.enable_bottom_up_incidences(false);
+#else
+	// the text is parsed in place from the mapped files
+	boost::interprocess::mapped_region node_region;
+	try
+	{
+		boost::interprocess::file_mapping node_file((input_pathname.string() + ".node").c_str(), boost::interprocess::read_only);
+		node_region = boost::interprocess::mapped_region(node_file, boost::interprocess::read_only);
+	}
+	catch (const boost::interprocess::interprocess_exception&)
+	{
+		std::cerr << "read_tet: failed to open .node file \"" << filename << "\", exit" << std::endl;
+		exit(EXIT_FAILURE);
+	}
 
-	std::cout << "  enable_vertex_bottom_up_incidences(true)..." << std::endl;
-	// otherwise add_edge makes an expensive quadratic search
-	mesh.enable_vertex_bottom_up_incidences(true);
+	boost::interprocess::mapped_region tetra_region;
+	try
+	{
+		boost::interprocess::file_mapping tetra_file((input_pathname.string() + ".ele").c_str(), boost::interprocess::read_only);
+		tetra_region = boost::interprocess::mapped_region(tetra_file, boost::interprocess::read_only);
+	}
+	catch (const boost::interprocess::interprocess_exception&)
+	{
+		std::cerr << "read_tet: failed to open .ele file \"" << filename << "\", exit" << std::endl;
+		exit(EXIT_FAILURE);
+	}
 
-	std::cout << "  read_tetras..." << std::endl;
-	read_tetras(generator, ele);
+	const char* node_text = static_cast<const char*>(node_region.get_address());
+	const char* tetra_text = static_cast<const char*>(tetra_region.get_address());
 
-	// now we can free some memory which is needed for other data structures:
-	// this caused to performance penalty (tested on NewFineMesh.1 -p)
-	// no longer true, needed for vc_iter
-	//std::cout << "  enable_vertex_bottom_up_incidences(false)..." << std::endl;
-	//mesh.enable_vertex_bottom_up_incidences(false);
+	read_tet(mesh, node_text, node_text + node_region.get_size(), tetra_text, tetra_text + tetra_region.get_size(), num_threads);
 
-	// otherwise would break later calls to some iterators (which?)
-	std::cout << "  enable_edge_bottom_up_incidences(true)..." << std::endl;
-	mesh.enable_edge_bottom_up_incidences(true);
+	if (use_cache)
+		write_mesh_cache(mesh, filename);
+#endif
+}
 
-	// otherwise would break later calls to some iterators (which?)
-	std::cout << "  enable_face_bottom_up_incidences(true)..." << std::endl;
-	mesh.enable_face_bottom_up_incidences(true);
+void read_tet(Mesh& mesh, std::istream& node, std::istream& ele)
+{
+	std::string node_text(std::istreambuf_iterator<char>(node), {});
+	std::string tetra_text(std::istreambuf_iterator<char>(ele), {});
 
-	std::cout << "read_tet finished." << std::endl;
+	read_tet(mesh, node_text.data(), node_text.data() + node_text.size(), tetra_text.data(), tetra_text.data() + tetra_text.size(), 1);
 }
@@ -2,8 +2,11 @@
 
 /*
 	read tetgen output. filename must not include extensions
+	with use_cache, the mesh is read from a binary cache next to the tetgen files if that is up to date,
+	otherwise the cache is written after reading the tetgen files
+	the files are memory mapped and large ones are parsed in chunks on num_threads threads
 */
-void read_tet(Mesh &mesh, std::string filename);
+void read_tet(Mesh &mesh, std::string filename, bool use_cache = false, int num_threads = 1);
 
 // Read tetgen output from a set of streams
 void read_tet(Mesh& mesh, std::istream& node, std::istream& ele);
@@ -1,4 +1,7 @@
 #include "statistics.h"
+#include "parallel.h"
+
+#include <array>
 
 void dump_mesh(Mesh &mesh)
 {
@@ -31,58 +34,131 @@ void dump_mesh(Mesh &mesh)
 }
 
 
-void print_edge_statistics(const Mesh &mesh)
-{
-	double min_lenght = std::numeric_limits<double>::max();
-	double max_lenght = 0;
-
-	EdgeHandle min_eh = Kernel::InvalidEdgeHandle;
-	EdgeHandle max_eh = Kernel::InvalidEdgeHandle;
+const int num_bins = 10;
 
-	int num_edges = 0;
+// min and max of one value per element together with the first elements attaining them,
+// the sum of all values and a histogram of num_bins equal bins from min to max.
+struct ValueStatistics
+{
+	ValueStatistics()
+		: min(std::numeric_limits<double>::max()), max(std::numeric_limits<double>::lowest()), sum(0), min_index(0), max_index(0), histo()
+	{
+	}
 
-	for (auto e_it = mesh.edges_begin(); e_it != mesh.edges_end(); ++e_it)
+	void add(double value, size_t index)
 	{
-		EdgeHandle eh = *e_it;
+		if (value < min)
+		{
+			min = value;
+			min_index = index;
+		}
+		if (value > max)
+		{
+			max = value;
+			max_index = index;
+		}
+		sum += value;
+	}
 
-		double lenght = mesh.length(eh);
-		if (lenght < min_lenght)
+	// other covers later elements, so ties keep the first element as a serial pass does
+	void merge(const ValueStatistics &other)
+	{
+		if (other.min < min)
 		{
-			min_lenght = lenght;
-			min_eh = eh;
+			min = other.min;
+			min_index = other.min_index;
 		}
-		if (lenght > max_lenght)
+		if (other.max > max)
 		{
-			max_lenght = lenght;
-			max_eh = eh;
+			max = other.max;
+			max_index = other.max_index;
 		}
+		sum += other.sum;
+	}
 
-		++num_edges;
+	int bin(double value) const
+	{
+		int bin = (int)(num_bins * (value - min) / (max - min));
+		if (bin == num_bins)
+			--bin;
+		return bin;
 	}
 
-	std::cout << "min edge length: " << min_lenght << " edge (from,to) vertex: " << mesh.edge(min_eh) << std::endl;
-	std::cout << "max edge length: " << max_lenght << " edge (from,to) vertex: " << mesh.edge(max_eh) << std::endl;
+	double min;
+	double max;
+	double sum;
+	size_t min_index;
+	size_t max_index;
+	size_t histo[num_bins];
+};
+
+// statistics of the count values that values(i, v) writes to v[0..count) for each element i in [0,n).
+// the first pass takes min, max and sum, the second one computes the values again and fills the histograms,
+// so values should be cheap and must give the same results in both passes.
+// chunks are reduced in parallel and merged in order, so the results do not depend on the number of threads.
+template <size_t count, class Values>
+static std::array<ValueStatistics, count> value_statistics(size_t n, int num_threads, Values values)
+{
+	const size_t chunk_size = 65536;
+	size_t num_chunks = (n + chunk_size - 1) / chunk_size;
+
+	std::vector<std::array<ValueStatistics, count>> chunks(num_chunks);
+
+	parallel_for_chunks(n, chunk_size, num_threads, [&](size_t begin, size_t end, int)
+	{
+		std::array<ValueStatistics, count> &chunk = chunks[begin / chunk_size];
+		double v[count];
+		for (size_t i = begin; i < end; ++i)
+		{
+			values(i, v);
+			for (size_t k = 0; k < count; ++k)
+				chunk[k].add(v[k], i);
+		}
+	});
 
-	if (max_lenght > min_lenght) {
-		const int num_bins = 10;
-		int histo[num_bins];
-		for (int bin = 0; bin < num_bins; ++bin)
-			histo[bin] = 0;
+	std::array<ValueStatistics, count> statistics;
+	for (const auto &chunk : chunks)
+	{
+		for (size_t k = 0; k < count; ++k)
+			statistics[k].merge(chunk[k]);
+	}
 
-		for (auto e_it = mesh.edges_begin(); e_it != mesh.edges_end(); ++e_it)
+	// the histograms of the chunks are exact counts, they add up to the same bins in any order
+	parallel_for_chunks(n, chunk_size, num_threads, [&](size_t begin, size_t end, int)
+	{
+		std::array<ValueStatistics, count> &chunk = chunks[begin / chunk_size];
+		double v[count];
+		for (size_t i = begin; i < end; ++i)
 		{
-			double lenght = mesh.length(*e_it);
-			int bin = (int)(num_bins * (lenght - min_lenght) / (max_lenght - min_lenght));
-			if (bin == num_bins)
-				--bin;
-			++histo[bin];
+			values(i, v);
+			for (size_t k = 0; k < count; ++k)
+			{
+				if (statistics[k].max > statistics[k].min)
+					++chunk[k].histo[statistics[k].bin(v[k])];
+			}
 		}
+	});
 
-		for (int bin = 0; bin < num_bins; ++bin)
+	for (const auto &chunk : chunks)
+	{
+		for (size_t k = 0; k < count; ++k)
 		{
-			std::cout << "edge histogram bin " << bin << " : " << histo[bin] << std::endl;
+			for (int bin = 0; bin < num_bins; ++bin)
+				statistics[k].histo[bin] += chunk[k].histo[bin];
 		}
 	}
+	return statistics;
+}
+
+static void print_histogram(const ValueStatistics &statistics, const char *name)
+{
+	if (!(statistics.max > statistics.min))
+		return;
+
+	for (int bin = 0; bin < num_bins; ++bin)
+	{
+		std::cout << name << " histogram bin " << bin << " : " << statistics.histo[bin] << std::endl;
+	}
 }
 
 //    1      |ax bx cx dx|
@@ -119,60 +195,27 @@ double tetrahedral_volume(const Mesh &mesh, CellHandle ch)
 	return volume;
 }
 
-void print_volume_statistics(const Mesh &mesh)
+void print_volume_statistics(const Mesh &mesh, int num_threads)
 {
-	double min_volume = std::numeric_limits<double>::max();
-	double max_volume = std::numeric_limits<double>::min();
-
-	CellHandle min_ch = Kernel::InvalidCellHandle;
-	CellHandle max_ch = Kernel::InvalidCellHandle;
-
-	for (auto c_it = mesh.cells_begin(); c_it != mesh.cells_end(); ++c_it)
-	{
-		CellHandle ch = *c_it;
-
-		double volume = tetrahedral_volume( mesh, ch );
-	
-		if (volume < min_volume)
-		{
-			min_volume = volume;
-			min_ch = ch;
-		}
-		if (volume > max_volume)
-		{
-			max_volume = volume;
-			max_ch = ch;
-		}
-	}
-
-	std::cout << "min cell volume: " << min_volume << " at cell: " << min_ch.idx() << std::endl;
-	std::cout << "max cell volume: " << max_volume << " at cell: " << max_ch.idx() << std::endl;
-
-	if (min_volume == max_volume)
-	{
+	if (mesh.n_cells() == 0)
 		return;
-	}
 
-	const int num_bins = 10;
-	int histo[num_bins];
-	for (int bin = 0; bin < num_bins; ++bin)
-		histo[bin] = 0;
+	// the cell vertex iteration is too slow to run twice, so the volumes are computed once and kept
+	std::vector<double> cell_volumes(mesh.n_cells());
+	parallel_for(mesh.n_cells(), num_threads, [&](size_t i, int)
+	{
+		cell_volumes[i] = tetrahedral_volume(mesh, CellHandle(static_cast<int>(i)));
+	});
 
-	for (auto c_it = mesh.cells_begin(); c_it != mesh.cells_end(); ++c_it)
+	ValueStatistics volumes = value_statistics<1>(mesh.n_cells(), num_threads, [&](size_t i, double *v)
 	{
-		CellHandle ch = *c_it;
+		v[0] = cell_volumes[i];
+	})[0];
 
-		double volume = tetrahedral_volume(mesh, ch);
-		int bin = (int)(num_bins * (volume - min_volume) / (max_volume - min_volume));
-		if (bin == num_bins)
-			--bin;
-		++histo[bin];
-	}
+	std::cout << "min cell volume: " << volumes.min << " at cell: " << volumes.min_index << std::endl;
+	std::cout << "max cell volume: " << volumes.max << " at cell: " << volumes.max_index << std::endl;
 
-	for (int bin = 0; bin < num_bins; ++bin)
-	{
-		std::cout << "cell volume histogram bin " << bin << " : " << histo[bin] << std::endl;
-	}
+	print_histogram(volumes, "cell volume");
 }
 
 void print_general_statistics(const Mesh &mesh)
@@ -185,127 +228,58 @@ void print_general_statistics(const Mesh &mesh)
 	std::cout << "genus   : " << mesh.genus() << std::endl;
 } 
 
-void print_mesh_statistics(const Mesh &mesh)
+void print_mesh_statistics(const Mesh &mesh, int num_threads)
 {
 	print_general_statistics(mesh);
-	print_edge_statistics(mesh);
-	print_volume_statistics(mesh);
+	print_volume_statistics(mesh, num_threads);
 }
 
-void print_steiner_point_face_statistics(const Mesh &mesh)
+void print_steiner_point_face_statistics(const Mesh &mesh, int num_threads)
 {
-	int min_f_nodes = std::numeric_limits<int>::max();
-	int max_f_nodes = std::numeric_limits<int>::min();
-	int total_f_nodes = 0;
-
-	int min_face = -1;
-	int max_face = -1;
-
-	for (auto fit = mesh.faces_begin(); fit != mesh.faces_end(); ++fit)
-	{
-		FaceHandle fh = *fit;
-		int f_nodes = mesh.f_nodes(fh).size();
-		total_f_nodes += f_nodes;
-		if (f_nodes < min_f_nodes)
-		{
-			min_f_nodes = f_nodes;
-			min_face = fh.idx();
-		}
-		if (f_nodes > max_f_nodes)
-		{
-			max_f_nodes = f_nodes;
-			max_face = fh.idx();
-		}
-	}
-
-	double avg_f_nodes = static_cast<double>(total_f_nodes) / mesh.n_faces();
-
-	std::cout << "min steiner nodes on a face: " << min_f_nodes << " face: " << min_face << std::endl;
-	std::cout << "avg steiner nodes on a face: " << avg_f_nodes << std::endl;
-	std::cout << "max steiner nodes on a face: " << max_f_nodes << " face: " << max_face << std::endl;
-
-	if (min_f_nodes == max_f_nodes)
+	if (mesh.n_faces() == 0)
 		return;
 
-	const int num_bins = 10;
-	int histo[num_bins];
-	for (int bin = 0; bin < num_bins; ++bin)
-		histo[bin] = 0;
-
-	for (auto fit = mesh.faces_begin(); fit != mesh.faces_end(); ++fit)
+	ValueStatistics f_nodes = value_statistics<1>(mesh.n_faces(), num_threads, [&](size_t i, double *v)
 	{
-		FaceHandle fh = *fit;
-		int f_nodes = mesh.f_nodes(fh).size();
-		int bin = (int)(num_bins * (f_nodes - min_f_nodes) / (max_f_nodes - min_f_nodes));
-		if (bin == num_bins)
-			--bin;
-		++histo[bin];
-	}
+		v[0] = static_cast<double>(mesh.f_nodes(FaceHandle(static_cast<int>(i))).size());
+	})[0];
 
-	for (int bin = 0; bin < num_bins; ++bin)
-	{
-		std::cout << "steiner nodes on a face histogram bin " << bin << " : " << histo[bin] << std::endl;
-	}
+	std::cout << "min steiner nodes on a face: " << static_cast<size_t>(f_nodes.min) << " face: " << f_nodes.min_index << std::endl;
+	std::cout << "avg steiner nodes on a face: " << f_nodes.sum / mesh.n_faces() << std::endl;
+	std::cout << "max steiner nodes on a face: " << static_cast<size_t>(f_nodes.max) << " face: " << f_nodes.max_index << std::endl;
+
+	print_histogram(f_nodes, "steiner nodes on a face");
 }
 
-void print_steiner_point_edge_statistics(const Mesh &mesh)
+// edge lengths and steiner nodes on the edges in one pass over the edges
+void print_steiner_point_edge_statistics(const Mesh &mesh, int num_threads)
 {
-	int min_e_nodes = std::numeric_limits<int>::max();
-	int max_e_nodes = std::numeric_limits<int>::min();
-	int total_e_nodes = 0;
-
-	EdgeHandle min_eh = Kernel::InvalidEdgeHandle;	
-	EdgeHandle max_eh = Kernel::InvalidEdgeHandle;
+	if (mesh.n_edges() == 0)
+		return;
 
-	for (auto eit = mesh.edges_begin(); eit != mesh.edges_end(); ++eit)
+	std::array<ValueStatistics, 2> edges = value_statistics<2>(mesh.n_edges(), num_threads, [&](size_t i, double *v)
 	{
-		EdgeHandle eh = *eit;
-		int e_nodes = mesh.e_nodes(eh).size();
-		total_e_nodes += e_nodes;
-		if (e_nodes < min_e_nodes)
-		{
-			min_e_nodes = e_nodes;
-			min_eh = eh;
-		}
-		if (e_nodes > max_e_nodes)
-		{
-			max_e_nodes = e_nodes;
-			max_eh = eh;
-		}
-	}
-
-	double avg_e_nodes = static_cast<double>(total_e_nodes) / mesh.n_edges();
-
-	std::cout << "min steiner nodes on a edge: " << min_e_nodes << " edge (from,to) vertex: " << mesh.edge(min_eh) << std::endl;
-	std::cout << "avg steiner nodes on a edge: " << avg_e_nodes << std::endl;
-	std::cout << "max steiner nodes on a edge: " << max_e_nodes << " edge (from,to) vertex: " << mesh.edge(max_eh) << std::endl;
+		EdgeHandle eh(static_cast<int>(i));
+		v[0] = mesh.length(eh);
+		v[1] = static_cast<double>(mesh.e_nodes(eh).size());
+	});
+	const ValueStatistics &lengths = edges[0];
+	const ValueStatistics &e_nodes = edges[1];
 
-	if (min_e_nodes == max_e_nodes)
-		return;
+	std::cout << "min edge length: " << lengths.min << " edge (from,to) vertex: " << mesh.edge(EdgeHandle(static_cast<int>(lengths.min_index))) << std::endl;
+	std::cout << "max edge length: " << lengths.max << " edge (from,to) vertex: " << mesh.edge(EdgeHandle(static_cast<int>(lengths.max_index))) << std::endl;
 
-	const int num_bins = 10;
-	int histo[num_bins];
-	for (int bin = 0; bin < num_bins; ++bin)
-		histo[bin] = 0;
+	print_histogram(lengths, "edge");
 
-	for (auto eit = mesh.edges_begin(); eit != mesh.edges_end(); ++eit)
-	{
-		EdgeHandle eh = *eit;
-		size_t e_nodes = mesh.e_nodes(eh).size();
-		int bin = (int)(num_bins * (e_nodes - min_e_nodes) / (max_e_nodes - min_e_nodes));
-		if (bin == num_bins)
-			--bin;
-		++histo[bin];
-	}
+	std::cout << "min steiner nodes on a edge: " << static_cast<size_t>(e_nodes.min) << " edge (from,to) vertex: " << mesh.edge(EdgeHandle(static_cast<int>(e_nodes.min_index))) << std::endl;
+	std::cout << "avg steiner nodes on a edge: " << e_nodes.sum / mesh.n_edges() << std::endl;
+	std::cout << "max steiner nodes on a edge: " << static_cast<size_t>(e_nodes.max) << " edge (from,to) vertex: " << mesh.edge(EdgeHandle(static_cast<int>(e_nodes.max_index))) << std::endl;
 
-	for (int bin = 0; bin < num_bins; ++bin)
-	{
-		std::cout << "steiner nodes on a edge histogram bin " << bin << " : " << histo[bin] << std::endl;
-	}
+	print_histogram(e_nodes, "steiner nodes on a edge");
 }
 
-void print_steiner_point_statistics(const Mesh &mesh)
+void print_steiner_point_statistics(const Mesh &mesh, int num_threads)
 {
-	print_steiner_point_edge_statistics(mesh);
-	print_steiner_point_face_statistics(mesh);
+	print_steiner_point_edge_statistics(mesh, num_threads);
+	print_steiner_point_face_statistics(mesh, num_threads);
 }
\ No newline at end of file
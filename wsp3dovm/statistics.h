@@ -2,6 +2,8 @@
 
 void dump_mesh(const Mesh &mesh);
 
-void print_mesh_statistics(const Mesh &mesh);
+// the statistics passes run on num_threads threads (0: all hardware threads), the output does not depend on it
+void print_mesh_statistics(const Mesh &mesh, int num_threads = 1);
 
-void print_steiner_point_statistics(const Mesh &mesh);
+// the edge lengths are printed here, they share one pass over the edges with the steiner nodes on them
+void print_steiner_point_statistics(const Mesh &mesh, int num_threads = 1);
\ No newline at end of file
@@ -9,13 +9,17 @@ Options::Options(int start_vertex,
                  int random_s_t_vertices,
                  double spanner_stretch,
                  double yardstick,
-                 bool use_random_cellweights)
+                 bool use_random_cellweights,
+                 std::string algorithm,
+                 std::string vtk_format)
     : start_vertex(start_vertex),
       termination_vertex(termination_vertex),
       random_s_t_vertices(random_s_t_vertices),
       spanner_stretch(spanner_stretch),
       yardstick(yardstick),
-      use_random_cellweights(use_random_cellweights) {
+      use_random_cellweights(use_random_cellweights),
+      algorithm(algorithm),
+      vtk_format(vtk_format) {
 }
 
 WspResult::WspResult(std::string mesh_vtk,
@@ -49,7 +53,11 @@ std::string gen_vtk(std::string node, std::string ele) {
 EMSCRIPTEN_BINDINGS(wsp3dovm_wasm) {
     emscripten::class_<Options>("Options")
         .constructor<int, int, int, double, double, bool>()
-        .property("startVertex", &Options::start_vertex);
+        .constructor<int, int, int, double, double, bool, std::string>()
+        .constructor<int, int, int, double, double, bool, std::string, std::string>()
+        .property("startVertex", &Options::start_vertex)
+        .property("algorithm", &Options::algorithm)
+        .property("vtkFormat", &Options::vtk_format);
 
     emscripten::class_<WspResult>("WspResult")
         .constructor<std::string, std::string, std::string, std::string, std::string, double>()
@@ -57,7 +65,12 @@ EMSCRIPTEN_BINDINGS(wsp3dovm_wasm) {
         .property("steinerGraphVtk", &WspResult::get_steiner_graph_vtk)
         .property("shortestPathTreeVtk", &WspResult::get_shortest_path_tree_vtk)
         .property("shortestPathFromToVtk", &WspResult::get_shortest_path_from_to_vtk)
-        .property("shortestPathCellsFromToVtk", &WspResult::get_shortest_path_cells_from_to_vtk);
+        .property("shortestPathCellsFromToVtk", &WspResult::get_shortest_path_cells_from_to_vtk)
+        .property("meshVtkBytes", &WspResult::get_mesh_vtk_bytes)
+        .property("steinerGraphVtkBytes", &WspResult::get_steiner_graph_vtk_bytes)
+        .property("shortestPathTreeVtkBytes", &WspResult::get_shortest_path_tree_vtk_bytes)
+        .property("shortestPathFromToVtkBytes", &WspResult::get_shortest_path_from_to_vtk_bytes)
+        .property("shortestPathCellsFromToVtkBytes", &WspResult::get_shortest_path_cells_from_to_vtk_bytes);
 
     emscripten::function("genVtk", &gen_vtk);
 }
@@ -13,13 +13,17 @@ struct Options {
     double spanner_stretch;
     double yardstick;
     bool use_random_cellweights;
+    std::string algorithm; // s-t query algorithm: "dijkstra", "bidirectional" or "astar"
+    std::string vtk_format; // encoding of the vtk results: "ascii" or "binary"
 
     Options(int start_vertex = -1,
             int termination_vertex = -1,
             int random_s_t_vertices = 0,
             double spanner_stretch = 0.0,
             double yardstick = 0.0,
-            bool use_random_cellweights = false);
+            bool use_random_cellweights = false,
+            std::string algorithm = "dijkstra",
+            std::string vtk_format = "ascii");
 };
 
 class WspResult {
@@ -45,6 +49,18 @@ public:
     std::string get_shortest_path_from_to_vtk() const { return shortest_path_from_to_vtk; }
     std::string get_shortest_path_cells_from_to_vtk() const { return shortest_path_cells_from_to_vtk; }
     double get_approx_ratio() const { return approx_ratio; }
+
+    // the vtk results as bytes (Uint8Array views into this object), needed for binary vtk
+    emscripten::val get_mesh_vtk_bytes() const { return bytes(mesh_vtk); }
+    emscripten::val get_steiner_graph_vtk_bytes() const { return bytes(steiner_graph_vtk); }
+    emscripten::val get_shortest_path_tree_vtk_bytes() const { return bytes(shortest_path_tree_vtk); }
+    emscripten::val get_shortest_path_from_to_vtk_bytes() const { return bytes(shortest_path_from_to_vtk); }
+    emscripten::val get_shortest_path_cells_from_to_vtk_bytes() const { return bytes(shortest_path_cells_from_to_vtk); }
+
+private:
+    static emscripten::val bytes(const std::string& data) {
+        return emscripten::val(emscripten::typed_memory_view(data.size(), reinterpret_cast<const unsigned char*>(data.data())));
+    }
 };
 
 // Convert the .node and .ele files into VTK format
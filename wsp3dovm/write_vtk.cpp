@@ -1,94 +1,299 @@
 #include "write_vtk.h"
 
-void write_shortest_path_tree_vtk
-(
-	const Graph& graph,
-	GraphNode_descriptor s,
-	const std::vector<GraphNode_descriptor>& predecessors,
-	const std::vector<double>& distances,
-	const std::string& filename
-)
+#include <boost/endian/conversion.hpp>
+
+#include <cstring>
+#include <unordered_map>
+
+bool parse_vtk_format(const std::string& name, VtkFormat& format)
+{
+	if (name == "ascii")
+		format = VTK_ASCII;
+	else if (name == "binary")
+		format = VTK_BINARY;
+	else
+		return false;
+	return true;
+}
+
+// writes the header and the data sections of a legacy vtk file as text or as big endian binary.
+// binary data is collected in a buffer that is written when full and at the end of a section. binary reals are single precision,
+// which is what ParaView renders with anyway, text reals are printed with the default 6 digits.
+class VtkWriter
+{
+public:
+	VtkWriter(std::ostream& output, VtkFormat format) : output(output), format(format), line_start(true) {}
+
+	void header(const std::string& title)
+	{
+		output <<
+			"# vtk DataFile Version 2.0\n" <<
+			title << "\n" <<
+			(format == VTK_BINARY ? "BINARY\n" : "ASCII\n") <<
+			"DATASET UNSTRUCTURED_GRID\n";
+	}
+
+	// type name of the reals for the POINTS and SCALARS keywords
+	const char* real_type() const
+	{
+		return format == VTK_BINARY ? "float" : "double";
+	}
+
+	void put(double value)
+	{
+		if (format == VTK_BINARY)
+		{
+			float single = static_cast<float>(value);
+			uint32_t bits;
+			std::memcpy(&bits, &single, sizeof(bits));
+			put_big_endian(bits);
+		}
+		else
+		{
+			separate();
+			output << value;
+		}
+	}
+
+	void put(int value)
+	{
+		if (format == VTK_BINARY)
+		{
+			put_big_endian(static_cast<uint32_t>(value));
+		}
+		else
+		{
+			separate();
+			output << value;
+		}
+	}
+
+	void put(const Point& point)
+	{
+		put(point[0]);
+		put(point[1]);
+		put(point[2]);
+	}
+
+	void end_line()
+	{
+		if (format == VTK_ASCII)
+			output << "\n";
+		line_start = true;
+	}
+
+	// binary data is followed by a newline before the next section keyword
+	void end_section()
+	{
+		if (format == VTK_BINARY)
+		{
+			flush();
+			output << "\n";
+		}
+	}
+
+private:
+	void separate()
+	{
+		if (!line_start)
+			output << " ";
+		line_start = false;
+	}
+
+	template <class T>
+	void put_big_endian(T value)
+	{
+		boost::endian::native_to_big_inplace(value);
+		const char* bytes = reinterpret_cast<const char*>(&value);
+		buffer.insert(buffer.end(), bytes, bytes + sizeof(value));
+		if (buffer.size() >= buffer_size)
+			flush();
+	}
+
+	void flush()
+	{
+		output.write(buffer.data(), buffer.size());
+		buffer.clear();
+	}
+
+	// large sections (cells of big graphs) are streamed, not duplicated in memory
+	static const size_t buffer_size = 1 << 20;
+
+	std::ostream& output;
+	VtkFormat format;
+	std::vector<char> buffer;
+	bool line_start;
+};
+
+static bool open_vtk_file(std::ofstream& file, const std::string& filename, VtkFormat format)
 {
-	std::ofstream file(filename, std::ios::trunc);
+	std::ios::openmode mode = std::ios::trunc;
+	if (format == VTK_BINARY)
+		mode |= std::ios::binary;
+
+	file.open(filename, mode);
 	if (!file.is_open())
 	{
 		std::cerr << "failed to open file " << filename << std::endl;
-		return;
+		return false;
 	}
-
-	write_shortest_path_tree_vtk(graph, s, predecessors, distances, file);
+	return true;
 }
 
-void write_shortest_path_tree_vtk
-(
-	const Graph& graph,
-	GraphNode_descriptor s,
-	const std::vector<GraphNode_descriptor>& predecessors,
-	const std::vector<double>& distances,
-	std::ostream& output
-)
+// the points of the given graph nodes, numbered in that order
+static void write_graph_points(VtkWriter& writer, const Graph& graph, std::ostream& output, const std::vector<GraphNode_descriptor>& nodes)
 {
-	size_t n = boost::num_vertices(graph);
-
-	output <<
-		"# vtk DataFile Version 2.0\n"
-		"shortest paths tree with root node " << graph[s].vh.idx() << "\n"
-		"ASCII\n"
-		"DATASET UNSTRUCTURED_GRID\n";
-	output << "POINTS " << n << " double\n";
+	output << "POINTS " << nodes.size() << " " << writer.real_type() << "\n";
 
-	std::vector<int> id(num_vertices(graph));
-	int i = 0;
-	Graph::vertex_iterator vertexIt, vertexEnd;
-	for (boost::tie(vertexIt, vertexEnd) = boost::vertices(graph); vertexIt != vertexEnd; ++vertexIt)
+	for (GraphNode_descriptor u : nodes)
 	{
-		GraphNode_descriptor v = *vertexIt;
-		id[v] = i++;
-		output << graph[v].point << "\n";
+		writer.put(graph_nodes(graph).point(u));
+		writer.end_line();
 	}
+	writer.end_section();
+}
 
-	output << "CELLS " << n << " " << 3 * n << "\n";
+// all graph nodes as points, id gives the point number of a node
+static void write_graph_points(VtkWriter& writer, const Graph& graph, std::ostream& output, std::vector<int>& id)
+{
+	output << "POINTS " << num_vertices(graph) << " " << writer.real_type() << "\n";
+
+	id.resize(num_vertices(graph));
+	int i = 0;
+	Graph::vertex_iterator vertexIt, vertexEnd;
 	for (boost::tie(vertexIt, vertexEnd) = boost::vertices(graph); vertexIt != vertexEnd; ++vertexIt)
 	{
 		GraphNode_descriptor u = *vertexIt;
-		GraphNode_descriptor v = predecessors[u];
-		output << "2 " << id[u] << " " << id[v] << "\n";
+		id[u] = i++;
+		writer.put(graph_nodes(graph).point(u));
+		writer.end_line();
 	}
+	writer.end_section();
+}
 
+// n cells of the same vtk cell type
+static void write_cell_types(VtkWriter& writer, std::ostream& output, size_t n, int type)
+{
 	output << "CELL_TYPES " << n << "\n";
 	for (size_t i = 0; i < n; ++i)
 	{
-		// vtk cell type 3 is line
-		output << "3" "\n";
+		writer.put(type);
+		writer.end_line();
 	}
+	writer.end_section();
+}
 
+// shortest path distances of the given graph nodes
+static void write_distances(VtkWriter& writer, std::ostream& output, const std::vector<GraphNode_descriptor>& nodes, const std::vector<double>& distances)
+{
 	output
-		<< "POINT_DATA " << n << "\n"
-		<< "SCALARS distance double 1\n"
+		<< "POINT_DATA " << nodes.size() << "\n"
+		<< "SCALARS distance " << writer.real_type() << " 1\n"
 		<< "LOOKUP_TABLE default\n";
 
-	for (boost::tie(vertexIt, vertexEnd) = boost::vertices(graph); vertexIt != vertexEnd; ++vertexIt)
+	for (GraphNode_descriptor u : nodes)
 	{
-		GraphNode_descriptor u = *vertexIt;
 		double distance = distances[u];
 		if (isfinite(distance))
 		{
-			output << distance << "\n";
+			writer.put(distance);
 		}
 		else
 		{
 			// ParaView cannot handle 1.#INF or the like in the .vtk file
 			// but we keep the value distinguishable from a normal 0
-			output << "-0\n";
+			writer.put(-0.0);
 		}
+		writer.end_line();
 	}
+	writer.end_section();
+}
+
+// the nodes of the shortest path from s to t, starting at t. only t if t is unreachable
+static std::vector<GraphNode_descriptor> path_nodes(const std::vector<GraphNode_descriptor>& predecessors, GraphNode_descriptor s, GraphNode_descriptor t)
+{
+	std::vector<GraphNode_descriptor> nodes(1, t);
+	for (GraphNode_descriptor r = t; r != s && predecessors[r] != r; r = predecessors[r])
+		nodes.push_back(predecessors[r]);
+	return nodes;
+}
+
+void write_shortest_path_tree_vtk
+(
+	const Graph& graph,
+	GraphNode_descriptor s,
+	const std::vector<GraphNode_descriptor>& predecessors,
+	const std::vector<double>& distances,
+	const std::string& filename,
+	VtkFormat format
+)
+{
+	std::ofstream file;
+	if (!open_vtk_file(file, filename, format))
+		return;
+
+	write_shortest_path_tree_vtk(graph, s, predecessors, distances, file, format);
+}
+
+void write_shortest_path_tree_vtk
+(
+	const Graph& graph,
+	GraphNode_descriptor s,
+	const std::vector<GraphNode_descriptor>& predecessors,
+	const std::vector<double>& distances,
+	std::ostream& output,
+	VtkFormat format
+)
+{
+	VtkWriter writer(output, format);
+
+	std::ostringstream title;
+	title << "shortest paths tree with root node " << graph_nodes(graph).vh(s).idx();
+	writer.header(title.str());
+
+	// only the nodes reached from s are part of the tree
+	std::vector<GraphNode_descriptor> nodes;
+	std::vector<int> id(num_vertices(graph), -1);
+	Graph::vertex_iterator vertexIt, vertexEnd;
+	for (boost::tie(vertexIt, vertexEnd) = boost::vertices(graph); vertexIt != vertexEnd; ++vertexIt)
+	{
+		GraphNode_descriptor u = *vertexIt;
+		if (isfinite(distances[u]))
+		{
+			id[u] = static_cast<int>(nodes.size());
+			nodes.push_back(u);
+		}
+	}
+
+	write_graph_points(writer, graph, output, nodes);
+
+	// one line to the predecessor for each node but the root
+	size_t n = nodes.empty() ? 0 : nodes.size() - 1;
+
+	output << "CELLS " << n << " " << 3 * n << "\n";
+	for (GraphNode_descriptor u : nodes)
+	{
+		GraphNode_descriptor v = predecessors[u];
+		if (u == v)
+			continue;
+		writer.put(2);
+		writer.put(id[u]);
+		writer.put(id[v]);
+		writer.end_line();
+	}
+	writer.end_section();
+
+	// vtk cell type 3 is line
+	write_cell_types(writer, output, n, 3);
+
+	write_distances(writer, output, nodes, distances);
 	output << "\n";
 }
 
 int hops(const std::vector<GraphNode_descriptor> &predecessors, GraphNode_descriptor s, GraphNode_descriptor t)
 {
 	int h = 0;
-	while (s != t)
+	while (s != t && predecessors[t] != t)
 	{
 		t = predecessors[t];
 		++h;
@@ -103,7 +308,8 @@ void write_shortest_path_from_to_vtk
 	GraphNode_descriptor t,
 	const std::vector<GraphNode_descriptor>& predecessors,
 	const std::vector<double>& distances,
-	const std::string& filename
+	const std::string& filename,
+	VtkFormat format
 )
 {
 	if (distances[t] == std::numeric_limits<double>::infinity())
@@ -114,20 +320,17 @@ void write_shortest_path_from_to_vtk
 	int h = hops(predecessors, s, t);
 
 	std::cout 
-	<< "from s=" << graph[s].vh.idx() 
-	<< " to t=" << graph[t].vh.idx() 
+	<< "from s=" << graph_nodes(graph).vh(s).idx() 
+	<< " to t=" << graph_nodes(graph).vh(t).idx() 
 	<< " distance=" << distances[t]
 	<< " #hops = " << h 
 	<< std::endl;
 
-	std::ofstream file(filename, std::ios::trunc);
-	if (!file.is_open())
-	{
-		std::cerr << "failed to open file " << filename << std::endl;
+	std::ofstream file;
+	if (!open_vtk_file(file, filename, format))
 		return;
-	}
 
-	write_shortest_path_from_to_vtk(graph, s, t, predecessors, distances, file);
+	write_shortest_path_from_to_vtk(graph, s, t, predecessors, distances, file, format);
 }
 
 void write_shortest_path_from_to_vtk
@@ -137,7 +340,8 @@ void write_shortest_path_from_to_vtk
 	GraphNode_descriptor t,
 	const std::vector<GraphNode_descriptor>& predecessors,
 	const std::vector<double>& distances,
-	std::ostream& output
+	std::ostream& output,
+	VtkFormat format
 )
 {
 	if (distances[t] == std::numeric_limits<double>::infinity())
@@ -148,112 +352,70 @@ void write_shortest_path_from_to_vtk
 	int h = hops(predecessors, s, t);
 
 	std::cout 
-	<< "from s=" << graph[s].vh.idx() 
-	<< " to t=" << graph[t].vh.idx() 
+	<< "from s=" << graph_nodes(graph).vh(s).idx() 
+	<< " to t=" << graph_nodes(graph).vh(t).idx() 
 	<< " distance=" << distances[t]
 	<< " #hops = " << h 
 	<< std::endl;
 
-	size_t n = boost::num_vertices(graph);
+	VtkWriter writer(output, format);
 
-	output <<
-		"# vtk DataFile Version 2.0\n"
-		"shortest path from " << graph[s].vh.idx() << " to " << graph[t].vh.idx() << "\n"
-		"ASCII\n"
-		"DATASET UNSTRUCTURED_GRID\n";
-	output << "POINTS " << n << " double\n";
+	std::ostringstream title;
+	title << "shortest path from " << graph_nodes(graph).vh(s).idx() << " to " << graph_nodes(graph).vh(t).idx();
+	writer.header(title.str());
 
-	std::vector<int> id(num_vertices(graph));
-	int i = 0;
-	Graph::vertex_iterator vertexIt, vertexEnd;
-	for (boost::tie(vertexIt, vertexEnd) = boost::vertices(graph); vertexIt != vertexEnd; ++vertexIt)
-	{
-		GraphNode_descriptor u = *vertexIt;
-		id[u] = i++;
-		output << graph[u].point << "\n";
-	}
+	// only the path nodes are written, point i is the i-th node from t
+	std::vector<GraphNode_descriptor> nodes = path_nodes(predecessors, s, t);
+	write_graph_points(writer, graph, output, nodes);
 
-	output << "CELLS " << h << " " << 3 * h << "\n";
-	for (GraphNode_descriptor r = t; r != s; r = predecessors[r])
-	{
-		GraphNode_descriptor v = predecessors[r];
-		output << "2 " << id[r] << " " << id[v] << "\n";
-	}
+	size_t n = nodes.size() - 1;
 
-	output << "CELL_TYPES " << h << "\n";
-	for (int i = 0; i < h; ++i)
+	output << "CELLS " << n << " " << 3 * n << "\n";
+	for (size_t i = 0; i < n; ++i)
 	{
-		// vtk cell type 3 is line
-		output << "3" "\n";
+		writer.put(2);
+		writer.put(static_cast<int>(i));
+		writer.put(static_cast<int>(i + 1));
+		writer.end_line();
 	}
+	writer.end_section();
 
-	output
-		<< "POINT_DATA " << n << "\n"
-		<< "SCALARS distance double 1\n"
-		<< "LOOKUP_TABLE default\n";
+	// vtk cell type 3 is line
+	write_cell_types(writer, output, n, 3);
 
-	for (boost::tie(vertexIt, vertexEnd) = boost::vertices(graph); vertexIt != vertexEnd; ++vertexIt)
-	{
-		GraphNode_descriptor u = *vertexIt;
-		double distance = distances[u];
-		if (isfinite(distance))
-		{
-			output << distance << "\n";
-		}
-		else
-		{
-			// ParaView cannot handle 1.#INF or the like in the .vtk file
-			// but we keep the value distinguishable from a normal 0
-			output << "-0\n";
-		}
-	}
+	write_distances(writer, output, nodes, distances);
 	output << "\n";
 }
 
-void write_vtk(const Mesh& mesh, const std::string& filename)
+void write_vtk(const Mesh& mesh, const std::string& filename, VtkFormat format)
 {
 	std::cout << "write_vtk " << filename << std::endl;
-	std::ofstream file(filename, std::ios::trunc);
-	if (!file.is_open())
-	{
-		std::cerr << "failed to open file " << filename << std::endl;
+	std::ofstream file;
+	if (!open_vtk_file(file, filename, format))
 		return;
-	}
 	
-	write_vtk(mesh, file);
+	write_vtk(mesh, file, format);
 	file.close();
 }
 
-void write_vtk(const Mesh& mesh, std::ostream& output)
+void write_vtk(const Mesh& mesh, std::ostream& output, VtkFormat format)
 {
 	int number_of_vertices = mesh.n_vertices();
 
-	output <<
-		"# vtk DataFile Version 2.0\n"
-		"tetrahedralization\n"
-		"ASCII\n"
-		"DATASET UNSTRUCTURED_GRID\n";
+	VtkWriter writer(output, format);
+	writer.header("tetrahedralization");
 
-	output << "POINTS " << number_of_vertices << " double\n";
-
-	std::map<VertexHandle, int> V;
-	int inum = 0;
+	output << "POINTS " << number_of_vertices << " " << writer.real_type() << "\n";
 
 	for (auto vit = mesh.vertices_begin(), end = mesh.vertices_end();
 		vit != end;
 		++vit
 	)
 	{
-		Point point = mesh.vertex(*vit);
-
-		output
-			<< point[0] << " "
-			<< point[1] << " "
-			<< point[2] << " "
-			<< "\n";
-
-		V[*vit] = inum++;
+		writer.put(mesh.vertex(*vit));
+		writer.end_line();
 	}
+	writer.end_section();
 
 	int number_of_cells = mesh.n_cells();
 
@@ -267,23 +429,20 @@ void write_vtk(const Mesh& mesh, std::ostream& output)
 	{
 		CellHandle ch = *cit;
 
-		output << "4 ";
+		writer.put(4);
 		for (auto vit = mesh.cv_iter(ch); vit; ++vit)
-			output << vit->idx() << " ";
+			writer.put(vit->idx());
 		
-		output << "\n";
+		writer.end_line();
 	}
+	writer.end_section();
 
-	output << "CELL_TYPES " << number_of_cells << "\n";
-	for (int i = 0; i < number_of_cells; ++i)
-	{
-		// vtk cell type 10 is tetrahedron
-		output << "10" "\n";
-	}
+	// vtk cell type 10 is tetrahedron
+	write_cell_types(writer, output, number_of_cells, 10);
 
 	output
 		<< "CELL_DATA " << number_of_cells << "\n"
-		<< "SCALARS weight double 1\n"
+		<< "SCALARS weight " << writer.real_type() << " 1\n"
 		<< "LOOKUP_TABLE default\n";
 
 	for (
@@ -291,78 +450,77 @@ void write_vtk(const Mesh& mesh, std::ostream& output)
 		cit != end;
 	++cit)
 	{
-		output << mesh.weight(*cit);
-		output << "\n";
+		writer.put(mesh.weight(*cit));
+		writer.end_line();
 	}
+	writer.end_section();
 }
 
 void write_graph_vtk
 (
 	const Graph &graph,
-	std::string filename
+	std::string filename,
+	VtkFormat format
 )
 {
-	std::ofstream file(filename, std::ios::trunc);
-	if (!file.is_open())
-	{
-		std::cerr << "failed to open file " << filename << std::endl;
+	std::ofstream file;
+	if (!open_vtk_file(file, filename, format))
 		return;
-	}
 
-	write_graph_vtk(graph, file);
+	write_graph_vtk(graph, file, format);
 }
 
 void write_graph_vtk
 (
 	const Graph& graph,
-	std::ostream& output
+	std::ostream& output,
+	VtkFormat format
 )
 {
-	output <<
-		"# vtk DataFile Version 2.0\n"
-		"steiner graph\n"
-		"ASCII\n"
-		"DATASET UNSTRUCTURED_GRID\n";
-	output << "POINTS " << num_vertices(graph) << " double\n";
-
-	std::vector<int> id(num_vertices(graph));
-	int i = 0;
-	Graph::vertex_iterator vertexIt, vertexEnd;
-	for (boost::tie(vertexIt, vertexEnd) = boost::vertices(graph); vertexIt != vertexEnd; ++vertexIt)
-	//for (auto v : graph.m_vertices )
-	{
-		GraphNode_descriptor u = *vertexIt;
-		id[u] = i++;
-		output << graph[u].point << "\n";
-	}
+	VtkWriter writer(output, format);
+	writer.header("steiner graph");
 
-	output << "CELLS " << num_edges(graph) << " " << 3 * num_edges(graph) << "\n";
-	for (auto e : graph.m_edges)
-	{
-		GraphNode_descriptor u = e.m_source;
-		GraphNode_descriptor v = e.m_target;
-		output << "2 " << id[u] << " " << id[v] << "\n";
-	}
+	std::vector<int> id;
+	write_graph_points(writer, graph, output, id);
+
+	// the graph stores each edge in both directions, we write the one with source < target only
+	size_t m = num_graph_edges(graph);
 
-	output << "CELL_TYPES " << num_edges(graph) << "\n";
-	for (size_t i = 0; i < num_edges(graph); ++i)
+	output << "CELLS " << m << " " << 3 * m << "\n";
+	Graph::edge_iterator edgeIt, edgeEnd;
+	for (boost::tie(edgeIt, edgeEnd) = boost::edges(graph); edgeIt != edgeEnd; ++edgeIt)
 	{
-		// vtk cell type 3 is line
-		output << "3" "\n";
+		GraphNode_descriptor u = boost::source(*edgeIt, graph);
+		GraphNode_descriptor v = boost::target(*edgeIt, graph);
+		if (u < v)
+		{
+			writer.put(2);
+			writer.put(id[u]);
+			writer.put(id[v]);
+			writer.end_line();
+		}
 	}
+	writer.end_section();
+
+	// vtk cell type 3 is line
+	write_cell_types(writer, output, m, 3);
 
 	// dump weight (not cost!) of edges to check that the adjacent  fetures have been calculated correctly
 	output
-		<< "CELL_DATA " << num_edges(graph) << "\n"
-		<< "SCALARS edge_weight double 1\n"
+		<< "CELL_DATA " << m << "\n"
+		<< "SCALARS edge_weight " << writer.real_type() << " 1\n"
 		<< "LOOKUP_TABLE default\n";
 
-	Graph::edge_iterator edgeIt, edgeEnd;
 	for (boost::tie(edgeIt, edgeEnd) = boost::edges(graph); edgeIt != edgeEnd; ++edgeIt)
 	{
 		GraphEdge_descriptor edge = *edgeIt;
-		output << graph[edge].weight << "\n";
+		if (boost::source(edge, graph) < boost::target(edge, graph))
+		{
+			writer.put(graph[edge].weight);
+			writer.end_line();
+		}
 	}
+	writer.end_section();
 	output << "\n";
 }
 
@@ -374,17 +532,15 @@ void write_shortest_path_cells_from_to_vtk
 	GraphNode_descriptor t,
 	const std::vector<GraphNode_descriptor>& predecessors,
 	const std::vector<double>& distances,
-	const std::string& filename
+	const std::string& filename,
+	VtkFormat format
 )
 {
-	std::ofstream file(filename, std::ios::trunc);
-	if (!file.is_open())
-	{
-		std::cerr << "failed to open file " << filename << std::endl;
+	std::ofstream file;
+	if (!open_vtk_file(file, filename, format))
 		return;
-	}
 
-	write_shortest_path_cells_from_to_vtk(graph, mesh, s, t, predecessors, distances, file);
+	write_shortest_path_cells_from_to_vtk(graph, mesh, s, t, predecessors, distances, file, format);
 }
 
 void write_shortest_path_cells_from_to_vtk
@@ -395,7 +551,8 @@ void write_shortest_path_cells_from_to_vtk
 	GraphNode_descriptor t,
 	const std::vector<GraphNode_descriptor>& predecessors,
 	const std::vector<double>& distances,
-	std::ostream& output
+	std::ostream& output,
+	VtkFormat format
 )
 {
 	if (distances[t] == std::numeric_limits<double>::infinity())
@@ -405,26 +562,31 @@ void write_shortest_path_cells_from_to_vtk
 
 	std::set<CellHandle> cells = cells_from_graph_nodes(graph, mesh, s, t, predecessors);
 
-	int h = hops(predecessors, s, t);
+	VtkWriter writer(output, format);
 
-	size_t n = boost::num_vertices(graph);
+	std::ostringstream title;
+	title << "cells along shortest path from " << graph_nodes(graph).vh(s).idx() << " to " << graph_nodes(graph).vh(t).idx();
+	writer.header(title.str());
 
-	output <<
-		"# vtk DataFile Version 2.0\n"
-		"cells along shortest path from " << graph[s].vh.idx() << " to " << graph[t].vh.idx() << "\n"
-		"ASCII\n"
-		"DATASET UNSTRUCTURED_GRID\n";
-	output << "POINTS " << n << " double\n";
+	// only the mesh vertices of the cells are written, numbered in order of appearance
+	std::vector<VertexHandle> vertices;
+	std::unordered_map<int, int> id;
+	for (CellHandle ch : cells)
+	{
+		for (auto vit = mesh.cv_iter(ch); vit; ++vit)
+		{
+			if (id.emplace(vit->idx(), static_cast<int>(vertices.size())).second)
+				vertices.push_back(*vit);
+		}
+	}
 
-	std::vector<int> id(num_vertices(graph));
-	int i = 0;
-	Graph::vertex_iterator vertexIt, vertexEnd;
-	for (boost::tie(vertexIt, vertexEnd) = boost::vertices(graph); vertexIt != vertexEnd; ++vertexIt)
+	output << "POINTS " << vertices.size() << " " << writer.real_type() << "\n";
+	for (VertexHandle vh : vertices)
 	{
-		GraphNode_descriptor u = *vertexIt;
-		id[u] = i++;
-		output << graph[u].point << "\n";
+		writer.put(mesh.vertex(vh));
+		writer.end_line();
 	}
+	writer.end_section();
 
 	output << "CELLS " << cells.size() << " " << 5 * cells.size() << "\n";
 	for (
@@ -435,23 +597,20 @@ void write_shortest_path_cells_from_to_vtk
 	{
 		CellHandle ch = *cit;
 
-		output << "4 ";
+		writer.put(4);
 		for (auto vit = mesh.cv_iter(ch); vit; ++vit)
-			output << vit->idx() << " ";
+			writer.put(id[vit->idx()]);
 
-		output << "\n";
+		writer.end_line();
 	}
+	writer.end_section();
 
-	output << "CELL_TYPES " << cells.size() << "\n";
-	for (int i = 0; i < cells.size(); ++i)
-	{
-		// vtk cell type 10 is tetra
-		output << "10" "\n";
-	}
+	// vtk cell type 10 is tetra
+	write_cell_types(writer, output, cells.size(), 10);
 
 	output
 		<< "CELL_DATA " << cells.size() << "\n"
-		<< "SCALARS cellweight double 1\n"
+		<< "SCALARS cellweight " << writer.real_type() << " 1\n"
 		<< "LOOKUP_TABLE default\n";
 
 	for (
@@ -461,6 +620,8 @@ void write_shortest_path_cells_from_to_vtk
 		)
 	{
 		CellHandle ch = *cit;
-		output << mesh.weight(ch) << "\n";
+		writer.put(mesh.weight(ch));
+		writer.end_line();
 	}
+	writer.end_section();
 }
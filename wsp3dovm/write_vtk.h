@@ -1,19 +1,32 @@
 #include "common.h"
 
+// legacy vtk file encoding. binary data is big endian with single precision points and scalars, ParaView reads both.
+// binary skips the text formatting, which makes writing several times faster, but the data is not compressed:
+// a number takes 4 bytes instead of its digits, which makes files only about 20% smaller for typical meshes.
+enum VtkFormat
+{
+	VTK_ASCII,
+	VTK_BINARY
+};
+
+// "ascii" or "binary", returns false for an unknown name
+bool parse_vtk_format(const std::string& name, VtkFormat& format);
+
 // write tetrahedralization in vtk format
-void write_vtk(const Mesh& mesh, std::ostream& output);
+void write_vtk(const Mesh& mesh, std::ostream& output, VtkFormat format = VTK_ASCII);
 
 // write tetrahedralization in vtk format to a file
-void write_vtk(const Mesh& mesh, const std::string& filename);
+void write_vtk(const Mesh& mesh, const std::string& filename, VtkFormat format = VTK_ASCII);
 
-// write single source shortest path tree in vtk format
+// write single source shortest path tree in vtk format, only the nodes reached from s are written
 void write_shortest_path_tree_vtk
 (
 	const Graph& graph,
 	GraphNode_descriptor s, 
 	const std::vector<GraphNode_descriptor>& predecessors,
 	const std::vector<double>& distances,
-	std::ostream& output
+	std::ostream& output,
+	VtkFormat format = VTK_ASCII
 );
 
 // write single source shortest path tree in vtk format to a file
@@ -23,10 +36,11 @@ void write_shortest_path_tree_vtk
 	GraphNode_descriptor s, 
 	const std::vector<GraphNode_descriptor>& predecessors,
 	const std::vector<double>& distances,
-	const std::string& filename
+	const std::string& filename,
+	VtkFormat format = VTK_ASCII
 );
 
-// write a longest shortest path in vtk format
+// write a longest shortest path in vtk format, only the path nodes are written
 void write_shortest_path_from_to_vtk
 (
 	const Graph& graph,
@@ -34,7 +48,8 @@ void write_shortest_path_from_to_vtk
 	GraphNode_descriptor t,
 	const std::vector<GraphNode_descriptor>& predecessors,
 	const std::vector<double>& distances,
-	std::ostream& filename
+	std::ostream& output,
+	VtkFormat format = VTK_ASCII
 );
 
 // write a longest shortest path in vtk format to a file
@@ -45,9 +60,11 @@ void write_shortest_path_from_to_vtk
 	GraphNode_descriptor t,
 	const std::vector<GraphNode_descriptor>& predecessors,
 	const std::vector<double>& distances,
-	const std::string& filename
+	const std::string& filename,
+	VtkFormat format = VTK_ASCII
 );
 
+// write the mesh cells along a shortest path in vtk format, only the vertices of these cells are written
 void write_shortest_path_cells_from_to_vtk
 (
 	const Graph& graph,
@@ -56,7 +73,8 @@ void write_shortest_path_cells_from_to_vtk
 	GraphNode_descriptor t,
 	const std::vector<GraphNode_descriptor>& predecessors,
 	const std::vector<double>& distances,
-	std::ostream& output
+	std::ostream& output,
+	VtkFormat format = VTK_ASCII
 );
 
 void write_shortest_path_cells_from_to_vtk
@@ -67,19 +85,22 @@ void write_shortest_path_cells_from_to_vtk
 	GraphNode_descriptor t,
 	const std::vector<GraphNode_descriptor>& predecessors,
 	const std::vector<double>& distances,
-	const std::string& filename
+	const std::string& filename,
+	VtkFormat format = VTK_ASCII
 );
 
 // write complete graph, mainly for debugging small examples
 void write_graph_vtk
 (
 	const Graph& graph,
-	std::string filename
+	std::string filename,
+	VtkFormat format = VTK_ASCII
 );
 
 void write_graph_vtk
 (
 	const Graph& graph,
-	std::ostream& output
+	std::ostream& output,
+	VtkFormat format = VTK_ASCII
 );
 